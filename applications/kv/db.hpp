@@ -121,71 +121,85 @@ public:
     return *this;
   }
 
-  bool read(const record_field_t& key, record_field_t& value, int idx) {
+  // Probe sequences are fetched this many slots at a time with one
+  // delegate::read_many rather than one round trip per slot.
+  static const int probe_window = 8;
+
+  // Walk the probe sequence of `key` and return the first slot that is empty
+  // or, if `match` is set, holds `key`; -1 if there is none within
+  // open_addr_limit. `r` receives the record in that slot.
+  int probe(const record_field_t& key, record& r, bool match) {
     int start_idx = hash(key) % SLOT_NUMBER;
-    for (int i = start_idx; i < start_idx + open_addr_limit; i++) {
-      record r = delegate::read(data + (i % SLOT_NUMBER));
-      LOG(INFO) << "Core " << Grappa::mycore() << " read key  " << idx << " hash:" <<
-        hash(key) << " actually:" << hash(r.key()) << " value:" << hash(r.value()) <<
-        " valid " << r.valid() << " at " << (i % SLOT_NUMBER);
-      if (!r.valid()) {
-        return false;
+    GlobalAddress<record> slots[probe_window];
+    record window[probe_window];
+    for (int i = start_idx; i < start_idx + open_addr_limit; i += probe_window) {
+      int n = start_idx + open_addr_limit - i;
+      if (n > probe_window) n = probe_window;
+      for (int j = 0; j < n; j++) {
+        slots[j] = data + ((i + j) % SLOT_NUMBER);
       }
-      if (r.key() == key) {
-        value = r.value();
-        return true;
+      delegate::read_many(slots, n, window);
+      for (int j = 0; j < n; j++) {
+        if (!window[j].valid() || (match && window[j].key() == key)) {
+          r = window[j];
+          return (i + j) % SLOT_NUMBER;
+        }
       }
     }
-    return false;
+    return -1;
+  }
+
+  bool read(const record_field_t& key, record_field_t& value, int idx) {
+    record r;
+    int slot = probe(key, r, true);
+    if (slot < 0) {
+      return false;
+    }
+    LOG(INFO) << "Core " << Grappa::mycore() << " read key  " << idx << " hash:" <<
+      hash(key) << " actually:" << hash(r.key()) << " value:" << hash(r.value()) <<
+      " valid " << r.valid() << " at " << slot;
+    if (!r.valid()) {
+      return false;
+    }
+    value = r.value();
+    return true;
   }
 
   bool update(const record_field_t& key, const record_field_t& value, int idx) {
-    int start_idx = hash(key) % SLOT_NUMBER;
-    for (int i = start_idx; i < start_idx + open_addr_limit; i++) {
-      record r = delegate::read(data + (i % SLOT_NUMBER));
-      if (!r.valid()) {
-        return false;
-      }
-      if (r.key() == key) {
-        r.value() = value;
-        delegate::write(data + (i % SLOT_NUMBER), r);
-        LOG(INFO) << "Core " << Grappa::mycore() << " write key  " << idx << " key:" <<
-          hash(key) << " value:" << hash(value) << " valid " << r.valid() << " at "
-          << (i % SLOT_NUMBER);
-        return true;
-      }
+    record r;
+    int slot = probe(key, r, true);
+    if (slot < 0 || !r.valid()) {
+      return false;
     }
-    return false;
+    r.value() = value;
+    delegate::write(data + slot, r);
+    LOG(INFO) << "Core " << Grappa::mycore() << " write key  " << idx << " key:" <<
+      hash(key) << " value:" << hash(value) << " valid " << r.valid() << " at "
+      << slot;
+    return true;
   }
 
   bool insert(const record_field_t& key, const record_field_t& value, int idx) {
-    int start_idx = hash(key) % SLOT_NUMBER;
-    for (int i = start_idx; i < start_idx + open_addr_limit; i++) {
-      record r = delegate::read(data + (i % SLOT_NUMBER));
-      if (!r.valid()) {
-        r.valid() = true;
-        r.key() = key;
-        r.value() = value;
-        delegate::write(data + (i % SLOT_NUMBER), r);
-        return true;
-      }
+    record r;
+    int slot = probe(key, r, false);
+    if (slot < 0) {
+      return false;
     }
-    return false;
+    r.valid() = true;
+    r.key() = key;
+    r.value() = value;
+    delegate::write(data + slot, r);
+    return true;
   }
 
   bool remove(const record_field_t& key) {
-    int start_idx = hash(key) % SLOT_NUMBER;
-    for (int i = start_idx; i < start_idx + open_addr_limit; i++) {
-      record r = delegate::read(data + (i % SLOT_NUMBER));
-      if (!r.valid()) {
-        return false;
-      }
-      if (r.key() == key) {
-        r.valid() = false;
-        delegate::write(data + (i % SLOT_NUMBER), r);
-        return true;
-      }
+    record r;
+    int slot = probe(key, r, true);
+    if (slot < 0 || !r.valid()) {
+      return false;
     }
-    return false;
+    r.valid() = false;
+    delegate::write(data + slot, r);
+    return true;
   }
 };
@@ -37,24 +37,32 @@ void do_pagerank(GlobalAddress<G> &g) {
     while (iter < 10) {
       double start_time = Grappa::walltime();
       iter++;
+      // Ranks written in this iteration are only read in the next one.
+      delegate::begin_epoch(EpochMode::ReadMostly);
       // iterate over all vertices of the graph
       forall(g, [=](VertexID vsid, G::Vertex& vs) {
           auto v = delegate::read(g->vs+vsid);
           if (v.nadj == 0) {
             return;
           }
-          bool update = false, init_update = false;
           
           double pr = 0.0;
-          forall<SyncMode::Blocking,nullptr>(adj(g,vs), [vsid,&v,&update,&init_update,g,&pr](G::Edge& e){
-            auto neighbour = delegate::read(g->vs+e.id);
+          // Start every neighbour read before waiting for any, so the
+          // misses overlap.
+          std::vector<delegate::ReadPromise<G::Vertex>> neighbours;
+          neighbours.reserve(vs.nadj);
+          for (int64_t i = 0; i < vs.nadj; i++) {
+            neighbours.push_back(delegate::read_async(g->vs+vs.local_adj[i]));
+          }
+          for (auto& n : neighbours) {
+            auto& neighbour = n.get();
             if (neighbour.nout == 0) {
                 pr += 0;
             }
             else {
                 pr += neighbour.data.weight / neighbour.nout;
             } 
-          });//forall_here
+          }
           pr *= FLAGS_damping; 
           if (abs(v.data.weight - pr) > FLAGS_epsilon) {
             nupdates++;
@@ -62,11 +70,11 @@ void do_pagerank(GlobalAddress<G> &g) {
             delegate::write(g->vs+vsid, v);
           }
       });//forall
+      delegate::end_epoch();
 
       uint32_t total_updates = reduce<uint32_t,collective_sum>(&nupdates);
       LOG(INFO) << "Iteration --> " << iter << " updates " << total_updates <<
         " in " << Grappa::walltime() - start_time << " s.";
-      Grappa::mypts() += FLAGS_lease;
 
       on_all_cores([iter]{ 
           nupdates = 0;
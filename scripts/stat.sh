@@ -30,6 +30,12 @@ expire_rate=$( echo "scale=4;$expire/$total*100" | bc )
 echo "Cache Hit: $hit_rate%"
 echo "Cache miss: $miss_rate%"
 echo "Cache Expire: $expire_rate%"
+renewed=$( cat $filename | grep -E "tardis_renewal_renewed|tardis_bg_renewed" |
+  awk -F, '{print $1}' | awk '{s+=$2} END {print s+0}' )
+echo "Lease Renewals: $renewed"
+jumps=$( cat $filename | grep "tardis_write_lease_jumps" |
+  awk -F, '{print $1}' | awk '{print $2}' )
+echo "Writes Past Live Leases: $jumps"
 net_bw=$( cat $filename | grep rdma_message_bytes |
   awk -F, '{print $1}' | awk '{print $2}')
 net_bw=$( echo "scale=4;$net_bw/1024/1024/1024" | bc )
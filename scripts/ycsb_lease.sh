@@ -0,0 +1,41 @@
+#!/bin/sh
+# Sweep the Tardis lease policies over YCSB read ratios; stat.sh reports
+# hit rate, renewals and lease-jumped writes for each run.
+
+export GLOG_minloglevel=1
+tardis=1
+cd build/Make+Release &&
+  make -j16 &&
+  make -j16 demo-ycsb
+
+object_number=250000
+
+for read_ratio in 0.5 0.9 0.99
+do
+for alpha in 0.99
+do
+for cache_percentage in 10
+do
+  cache_number=$(awk "BEGIN {print $object_number*$cache_percentage/100}")
+
+  for policy in linear exponential ratio
+  do
+  echo "Read: $read_ratio"
+  echo "Alpha; $alpha"
+  echo "Cache: $cache_percentage%"
+  echo "Lease policy: $policy"
+  salloc -N1 -n16 mpirun applications/kv/ycsb.exe \
+    -constant=false \
+    -alpha=$alpha \
+    -read_propotion=$read_ratio \
+    -cache_proto=$tardis \
+    -max_cache_number=$cache_number \
+    -tardis_lease_policy=$policy \
+    -tardis_renewal=adaptive \
+    -loop_threshold=120 &&
+    sh ../../stat.sh
+  done
+
+done
+done
+done
@@ -53,6 +53,9 @@
 /// bits store core id and address on core encoded in a way that makes
 /// incrementing by blocks work.
 
+#include <algorithm>
+#include <limits>
+#include <type_traits>
 #include "Communicator.hpp"
 #include "TardisCache.hpp"
 
@@ -63,6 +66,7 @@ typedef int Pool;
 namespace Grappa {
 namespace impl {
 extern void * global_memory_chunk_base;
+extern size_t global_memory_chunk_size;
 }
 }
 
@@ -76,6 +80,9 @@ static const int block_size = BLOCK_SIZE;
 
 #define GRAPPA_BLOCK_ALIGNED __attribute__((aligned(BLOCK_SIZE)))
 
+static_assert(sizeof(Grappa::impl::cache_block) == BLOCK_SIZE,
+    "a cached block must be exactly one global block");
+
 /// How many address type bits?
 static const int tag_bits = 1;
 /// How many address bits?
@@ -113,159 +120,81 @@ public:
   bool is_owner(void) { return Grappa::mycore() == core(); }
   static tardis_o_t& find_tardis_owner_info( const GlobalAddress<T>& g ) {
     CHECK(FLAGS_cache_proto == GRAPPA_TARDIS);
-    auto& owner_cache = GlobalCacheData::tardis_owner_cache;
-    auto iter = owner_cache.find(g.raw_bits());
-    // Initial cold miss.
-    if (iter == owner_cache.end()) {
-      owner_cache[g.raw_bits()] = tardis_o_t();
-      return owner_cache[g.raw_bits()];
-    }
-    return iter->second;
+    return find_owner_info(GlobalCacheData::tardis_owner_cache, g);
   }
 
   static wi_o_t& find_wi_owner_info( const GlobalAddress<T>& g ) {
     CHECK(FLAGS_cache_proto == GRAPPA_WI);
-    auto& owner_cache = GlobalCacheData::wi_owner_cache;
-    auto iter = owner_cache.find(g.raw_bits());
-    // Initial cold miss.
-    if (iter == owner_cache.end()) {
-      owner_cache[g.raw_bits()] = wi_o_t();
-      return owner_cache[g.raw_bits()];
-    }
-    return iter->second;
+    return find_owner_info(GlobalCacheData::wi_owner_cache, g);
   }
 
   static tardis_c_t& find_tardis_cache( const GlobalAddress<T>& g,
       bool* valid = nullptr, bool insert_new = true) {
     CHECK(FLAGS_cache_proto == GRAPPA_TARDIS);
-    auto& cache = GlobalCacheData::tardis_cache;
-    std::list<uintptr_t>& lru = GlobalCacheData::lru;
-
-    CHECK(cache.size() == lru.size());
-
-    auto it = cache.find(g.raw_bits());
-    void *freed_space = nullptr;
-    if (it == cache.end()) {
-      if (valid != nullptr) { *valid = false; }
-      // Return a stub
-      if (!insert_new) { return cache.begin()->second; }
-      while (lru.size() >= FLAGS_max_cache_number) {
-        auto victim = lru.rbegin();
-        while (victim != lru.rend() &&
-          cache[*victim].usedcnt > 0)
-          victim++;
-        if (victim != lru.rend()) {
-          auto v = cache.find(*victim);
-          if (v->second.size == sizeof(T)) {
-            if (freed_space != nullptr) {
-              free(freed_space);
-            }
-            freed_space = v->second.object;
-          }
-          else {
-            free(v->second.object);
-          }
-          lru.erase(v->second.lru_iter);
-          cache.erase(v);
-        }
-      }
-
-      if (freed_space == nullptr) {
-        freed_space = malloc(sizeof(T));
-        CHECK(freed_space != nullptr);
-      }
-      lru.push_front(g.raw_bits());
-      auto& r = cache[g.raw_bits()] = tardis_c_t(freed_space, sizeof(T));
-      r.lru_iter = lru.begin();
-      r.usedcnt++;
-
-      return r;
-    }
-    if (valid != nullptr) { *valid = true; }
-    lru.erase(it->second.lru_iter);
-    lru.push_front(g.raw_bits());
-    it->second.lru_iter = lru.begin();
-    // Inv request don't need to increase usedcnt.
-    if (insert_new) {
-      it->second.usedcnt++;
-    }
-    return it->second;
+    return find_cache(GlobalCacheData::tardis_cache, g, valid, insert_new);
   }
 
   static wi_c_t& find_wi_cache( const GlobalAddress<T>& g,
       bool* valid = nullptr, bool insert_new = true) {
     CHECK(FLAGS_cache_proto == GRAPPA_WI);
-    auto& cache = GlobalCacheData::wi_cache;
-    std::list<uintptr_t>& lru = GlobalCacheData::lru;
-
-    CHECK(cache.size() == lru.size());
-
-    auto it = cache.find(g.raw_bits());
-    void *freed_space = nullptr;
-    if (it == cache.end()) {
-      if (valid != nullptr) { *valid = false; }
-      // Return a stub
-      if (!insert_new) { return cache.begin()->second; }
-      while (lru.size() >= FLAGS_max_cache_number) {
-        auto victim = lru.rbegin();
-        while (victim != lru.rend() &&
-          cache[*victim].usedcnt > 0)
-          victim++;
-        if (victim != lru.rend()) {
-          auto v = cache.find(*victim);
-          if (v->second.size == sizeof(T)) {
-            if (freed_space != nullptr) {
-              free(freed_space);
-            }
-            freed_space = v->second.object;
-          }
-          else {
-            free(v->second.object);
-          }
-          lru.erase(v->second.lru_iter);
-          cache.erase(v);
-        }
-      }
+    return find_cache(GlobalCacheData::wi_cache, g, valid, insert_new);
+  }
 
-      if (freed_space == nullptr) {
-        freed_space = malloc(sizeof(T));
-        CHECK(freed_space != nullptr);
-      }
-      lru.push_front(g.raw_bits());
-      auto& r = cache[g.raw_bits()] = wi_c_t(freed_space, sizeof(T));
-      r.lru_iter = lru.begin();
-      r.usedcnt++;
+  /// Offset of g in its global block. Raw bits are signed, and the tag bit
+  /// of a 2D address makes them negative, so take them as unsigned.
+  static uintptr_t block_offset( const GlobalAddress<T>& g ) {
+    return static_cast<uintptr_t>(g.raw_bits()) % block_size;
+  }
 
-      return r;
-    }
-    if (valid != nullptr) { *valid = true; }
-    lru.erase(it->second.lru_iter);
-    lru.push_front(g.raw_bits());
-    it->second.lru_iter = lru.begin();
-    // Inv request don't need to increase usedcnt.
-    if (insert_new) {
-      it->second.usedcnt++;
-    }
-    return it->second;
+  /// Number of global blocks the object at g overlaps.
+  static size_t object_blocks( const GlobalAddress<T>& g ) {
+    return (block_offset(g) + sizeof(T) + block_size - 1) / block_size;
   }
 
-  static std::list<uintptr_t>::iterator get_lru_iter(void) {
-    return GlobalCacheData::lru.begin();
+  /// Raw bits of the i'th block holding part of the object at `raw`. An
+  /// object is contiguous on its core: past its first block, a 2D address
+  /// continues in the next block and a linear one in this core's next
+  /// block, a whole round of cores further on.
+  static uintptr_t block_key( uintptr_t raw, size_t i ) {
+    uintptr_t step = (raw & static_cast<uintptr_t>(tag_mask)) ? block_size :
+      static_cast<uintptr_t>(block_size) * global_communicator.cores;
+    return raw - raw % block_size + i * step;
   }
 
-  // WARNING: return value might not be typename T.
-  // Remember to deactive each object.
-  static std::vector<GlobalAddress<T>> get_expired(timestamp_t pts) {
-    auto& lru = GlobalCacheData::lru;
-    std::vector<GlobalAddress<T>> result;
+  /// Apply f to the owner metadata of every block the object at g
+  /// overlaps, in address order; the first is find_*_owner_info(g).
+  template <typename F>
+  static void for_each_tardis_owner_info( const GlobalAddress<T>& g, F f ) {
+    CHECK(FLAGS_cache_proto == GRAPPA_TARDIS);
+    for_each_owner_info(GlobalCacheData::tardis_owner_cache, g, f);
+  }
 
-    int max_update = 0;
-    for (auto iter = lru.begin(); iter != lru.end() &&
-      max_update < lru.size() / 2; iter++, max_update++) {
-      result.push_back(GlobalAddress<T>::Raw(*iter));
-    }
+  template <typename F>
+  static void for_each_wi_owner_info( const GlobalAddress<T>& g, F f ) {
+    CHECK(FLAGS_cache_proto == GRAPPA_WI);
+    for_each_owner_info(GlobalCacheData::wi_owner_cache, g, f);
+  }
 
-    return result;
+  /// Invalidate every copy cached here of an object overlapping any block
+  /// of the one at g, including cached copies of the blocks themselves: the
+  /// owner tracks sharers per block, so a write to any object in a block
+  /// invalidates them all. Returns false if nothing was cached.
+  static bool invalidate_wi_block( const GlobalAddress<T>& g ) {
+    CHECK(FLAGS_cache_proto == GRAPPA_WI);
+    auto& cache = GlobalCacheData::wi_cache;
+    auto& index = GlobalCacheData::wi_block_keys;
+    bool found = false;
+    for (size_t i = 0, n = object_blocks(g); i < n; i++) {
+      auto it = index.find(block_key(g.raw_bits(), i));
+      if (it == index.end()) continue;
+      for (uintptr_t key : it->second) {
+        wi_c_t* c = cache.peek(key);
+        DCHECK(c != nullptr) << "block index names uncached " << (void*)key;
+        c->valid = false;
+        found = true;
+      }
+    }
+    return found;
   }
 
   /*
@@ -273,31 +202,32 @@ public:
    * object at a time.
    */
   static void active_cache( Grappa::impl::cache_info_base& mycache ) {
+    CHECK_LT(mycache.refcnt, std::numeric_limits<decltype(mycache.refcnt)>::max())
+      << "too many tasks hold one cache entry";
     mycache.refcnt++;
   }
 
   // After this, the reference might become invalid.
   static void deactive_cache( Grappa::impl::cache_info_base& mycache ) {
     mycache.refcnt--;
-    mycache.usedcnt--;
+    if (FLAGS_cache_proto == GRAPPA_TARDIS) {
+      GlobalCacheData::tardis_cache.unpin(static_cast<tardis_c_t&>(mycache));
+    }
+    else if (FLAGS_cache_proto == GRAPPA_WI) {
+      GlobalCacheData::wi_cache.unpin(static_cast<wi_c_t&>(mycache));
+    }
   }
 
   static void free_cache(void) {
+    auto release = [](Grappa::impl::cache_info_base& c) {
+      GlobalCacheData::payload_arena.deallocate(c.object, c.size);
+      c.object = nullptr;
+    };
     if (FLAGS_cache_proto == GRAPPA_TARDIS) {
-      auto& cache = GlobalCacheData::tardis_cache;
-
-      for (auto it = cache.begin(); it != cache.end(); it++) {
-        free(it->second.object);
-        it->second.object = nullptr;
-      }
+      GlobalCacheData::tardis_cache.for_each(release);
     }
     else if (FLAGS_cache_proto == GRAPPA_WI) {
-      auto& cache = GlobalCacheData::wi_cache;
-
-      for (auto it = cache.begin(); it != cache.end(); it++) {
-        free(it->second.object);
-        it->second.object = nullptr;
-      }
+      GlobalCacheData::wi_cache.for_each(release);
     }
   }
 
@@ -305,19 +235,131 @@ public:
     free_cache();
     if (FLAGS_cache_proto == GRAPPA_TARDIS) {
       GlobalCacheData::tardis_owner_cache.clear();
+      GlobalCacheData::tardis_hot_keys.clear();
       GlobalCacheData::tardis_cache.clear();
-      GlobalCacheData::lru.clear();
+      GlobalCacheData::locale_cache.clear();
       Grappa::mypts() = 0;
     }
     else if (FLAGS_cache_proto == GRAPPA_WI) {
       GlobalCacheData::wi_owner_cache.clear();
       GlobalCacheData::wi_cache.clear();
-      GlobalCacheData::lru.clear();
+      GlobalCacheData::wi_block_keys.clear();
     }
+    GlobalCacheData::payload_arena.clear();
   }
 
 private:
 
+  /// Metadata of the block holding an object this core owns. Coherence is
+  /// kept per block, so every object starting in a block shares one entry
+  /// with the block itself. The table shadows this core's part of the
+  /// global heap, and is set up on first use.
+  template <typename O>
+  static O& find_owner_info(Grappa::impl::OwnerTable<O>& table,
+      const GlobalAddress<T>& g, size_t block = 0) {
+    if (!table.initialized()) {
+      table.init(Grappa::impl::global_memory_chunk_base,
+          Grappa::impl::global_memory_chunk_size);
+    }
+    char* local = (char*)g.pointer() - block_offset(g) + block * block_size;
+    return table.find(block_key(g.raw_bits(), block), local);
+  }
+
+  template <typename O, typename F>
+  static void for_each_owner_info(Grappa::impl::OwnerTable<O>& table,
+      const GlobalAddress<T>& g, F f) {
+    for (size_t i = 0, n = object_blocks(g); i < n; i++) {
+      f(find_owner_info(table, g, i));
+    }
+  }
+
+  /// Keep GlobalCacheData::wi_block_keys in step with the WI cache: `key`
+  /// now holds `size` bytes, and `*old_key` (if given) was evicted for it.
+  static void index_wi_key( uintptr_t key, size_t size, const uintptr_t* old_key, size_t old_size ) {
+    auto& index = GlobalCacheData::wi_block_keys;
+    // Blocks overlapped by the copy cached under `k`.
+    auto blocks = [](uintptr_t k, size_t sz) {
+      return ((k & ~Grappa::impl::BLOCK_KEY_BIT) % block_size + sz + block_size - 1) / block_size;
+    };
+    if (old_key != nullptr) {
+      uintptr_t raw = *old_key & ~Grappa::impl::BLOCK_KEY_BIT;
+      for (size_t i = 0, n = blocks(*old_key, old_size); i < n; i++) {
+        auto it = index.find(block_key(raw, i));
+        CHECK(it != index.end()) << "evicted " << (void*)*old_key << " was not indexed";
+        auto& keys = it->second;
+        keys.erase(std::find(keys.begin(), keys.end(), *old_key));
+        if (keys.empty()) index.erase(it);
+      }
+    }
+    uintptr_t raw = key & ~Grappa::impl::BLOCK_KEY_BIT;
+    for (size_t i = 0, n = blocks(key, size); i < n; i++) {
+      index[block_key(raw, i)].push_back(key);
+    }
+  }
+
+  static void index_claim( Grappa::impl::CacheTable<tardis_c_t>&, uintptr_t,
+      size_t, const uintptr_t*, size_t ) {}
+
+  static void index_claim( Grappa::impl::CacheTable<wi_c_t>&, uintptr_t key,
+      size_t size, const uintptr_t* old_key, size_t old_size ) {
+    index_wi_key(key, size, old_key, old_size);
+  }
+
+  /// Cache key of g: its raw bits, tagged for whole blocks.
+  static uintptr_t cache_key( const GlobalAddress<T>& g ) {
+    return std::is_same<T, Grappa::impl::cache_block>::value ?
+      (g.raw_bits() | Grappa::impl::BLOCK_KEY_BIT) : g.raw_bits();
+  }
+
+  /// Look up (and by default insert) the cached copy of g. A miss claims an
+  /// entry from the table, evicting an unpinned one when it is full; the
+  /// victim's payload is reused when it falls in the same arena size class.
+  template <typename C>
+  static C& find_cache( Grappa::impl::CacheTable<C>& cache,
+      const GlobalAddress<T>& g, bool* valid, bool insert_new ) {
+    auto& arena = GlobalCacheData::payload_arena;
+    if (!cache.initialized()) {
+      cache.init(FLAGS_max_cache_number);
+      arena.init(FLAGS_max_cache_number);
+    }
+    C* hit = cache.find(cache_key(g));
+    if (hit != nullptr) {
+      if (valid != nullptr) { *valid = true; }
+      // Inv request don't need to increase usedcnt.
+      if (insert_new) {
+        cache.pin(*hit);
+      }
+      return *hit;
+    }
+    if (valid != nullptr) { *valid = false; }
+    // Return a stub
+    if (!insert_new) { return cache.stub(); }
+
+    void *freed_space;
+    size_t freed_size;
+    uintptr_t freed_key;
+    bool evicting = cache.full();
+    C& r = cache.claim(cache_key(g), &freed_space, &freed_size, &freed_key);
+    index_claim(cache, cache_key(g), sizeof(T),
+        evicting ? &freed_key : nullptr, freed_size);
+    if (freed_space != nullptr) {
+      if (Grappa::impl::CacheArena::same_class(freed_size, sizeof(T))) {
+        arena.resize(freed_size, sizeof(T));
+      } else {
+        arena.deallocate(freed_space, freed_size);
+        freed_space = nullptr;
+      }
+    }
+    if (freed_space == nullptr) {
+      freed_space = arena.allocate(sizeof(T));
+    }
+    r.object = freed_space;
+    r.size = sizeof(T);
+    cache.pin(r);
+
+    return r;
+  }
+
   /// Storage for address
   intptr_t storage_;
   //DISALLOW_COPY_AND_ASSIGN( GlobalAddress );
@@ -0,0 +1,166 @@
+#pragma once
+#include <stdint.h>
+#include <stdlib.h>
+#include <vector>
+#include <glog/logging.h>
+
+namespace Grappa {
+namespace impl {
+
+/// Size-class slab allocator for cached object payloads.
+///
+/// Payloads are rounded up to a power of two (16B .. 64KB) and carved out of
+/// large contiguous slabs, one slab list per size class. Freed payloads go on
+/// an intrusive per-class free list, so both eviction and refill are a
+/// pointer push/pop; a class only asks the system for memory when its free
+/// list and current slab are both exhausted. Slabs are never returned until
+/// the arena is destroyed; `clear()` recycles them.
+///
+/// Each core owns one arena (see GlobalCacheData), so there is no locking.
+class CacheArena {
+public:
+  static const int MIN_SHIFT = 4;
+  static const int MAX_SHIFT = 16;
+  static const int NUM_CLASSES = MAX_SHIFT - MIN_SHIFT + 1;
+  static const size_t SLAB_BYTES = 1 << 20;
+
+private:
+  struct free_obj { free_obj* next; };
+
+  struct size_class {
+    free_obj* free_list;
+    char* bump;
+    char* end;
+    // Slabs handed out so far; `next_slab` indexes the first unused one
+    // after a clear().
+    std::vector<std::pair<char*,size_t>> slabs;
+    size_t next_slab;
+    size_t live;
+  };
+
+  size_class classes_[NUM_CLASSES];
+  // Upper bound on live payloads (the cache table capacity).
+  size_t max_objects_;
+  size_t live_bytes_;
+  size_t reserved_bytes_;
+
+  static size_t class_bytes(int c) { return (size_t)1 << (c + MIN_SHIFT); }
+
+  void refill(int c) {
+    size_class& sc = classes_[c];
+    if (sc.next_slab < sc.slabs.size()) {
+      auto& s = sc.slabs[sc.next_slab++];
+      sc.bump = s.first;
+      sc.end = s.first + s.second;
+      return;
+    }
+    size_t obj = class_bytes(c);
+    size_t n = SLAB_BYTES / obj;
+    if (n == 0) n = 1;
+    // Never reserve more than the cache could ever hold of this class.
+    if (max_objects_ > 0 && n > max_objects_) n = max_objects_;
+    size_t bytes = n * obj;
+    void* p = nullptr;
+    CHECK_EQ(posix_memalign(&p, 64, bytes), 0) << "cache arena out of memory";
+    sc.slabs.push_back(std::make_pair((char*)p, bytes));
+    sc.next_slab = sc.slabs.size();
+    sc.bump = (char*)p;
+    sc.end = sc.bump + bytes;
+    reserved_bytes_ += bytes;
+  }
+
+public:
+  CacheArena() : max_objects_(0), live_bytes_(0), reserved_bytes_(0) {
+    for (auto& sc : classes_) {
+      sc.free_list = nullptr;
+      sc.bump = sc.end = nullptr;
+      sc.next_slab = 0;
+      sc.live = 0;
+    }
+  }
+
+  ~CacheArena() {
+    for (auto& sc : classes_) {
+      for (auto& s : sc.slabs) free(s.first);
+    }
+  }
+
+  /// Bound slab sizes by the number of payloads the cache can hold.
+  void init(size_t max_objects) { max_objects_ = max_objects; }
+
+  static int size_class_of(size_t size) {
+    CHECK_LE(size, class_bytes(NUM_CLASSES - 1)) << "cached object too large";
+    if (size <= class_bytes(0)) return 0;
+    return 64 - __builtin_clzll(size - 1) - MIN_SHIFT;
+  }
+
+  /// True if a payload of size `a` can be reused in place for size `b`.
+  static bool same_class(size_t a, size_t b) {
+    return size_class_of(a) == size_class_of(b);
+  }
+
+  void* allocate(size_t size) {
+    int c = size_class_of(size);
+    size_class& sc = classes_[c];
+    void* p;
+    if (sc.free_list != nullptr) {
+      p = sc.free_list;
+      sc.free_list = sc.free_list->next;
+    } else {
+      if (sc.bump == sc.end) refill(c);
+      p = sc.bump;
+      sc.bump += class_bytes(c);
+    }
+    sc.live++;
+    live_bytes_ += size;
+    return p;
+  }
+
+  void deallocate(void* p, size_t size) {
+    if (p == nullptr) return;
+    int c = size_class_of(size);
+    size_class& sc = classes_[c];
+    free_obj* f = (free_obj*)p;
+    f->next = sc.free_list;
+    sc.free_list = f;
+    sc.live--;
+    live_bytes_ -= size;
+  }
+
+  /// Account for a payload reused in place for an object of another size
+  /// in the same class.
+  void resize(size_t old_size, size_t new_size) {
+    live_bytes_ += new_size;
+    live_bytes_ -= old_size;
+  }
+
+  /// Drop every payload at once, keeping the slabs for reuse.
+  void clear() {
+    for (auto& sc : classes_) {
+      sc.free_list = nullptr;
+      sc.bump = sc.end = nullptr;
+      sc.next_slab = 0;
+      sc.live = 0;
+    }
+    live_bytes_ = 0;
+  }
+
+  size_t live_objects() const {
+    size_t n = 0;
+    for (auto& sc : classes_) n += sc.live;
+    return n;
+  }
+  /// Bytes requested by live payloads.
+  size_t live_bytes() const { return live_bytes_; }
+  /// Bytes obtained from the system for slabs.
+  size_t reserved_bytes() const { return reserved_bytes_; }
+  /// Fraction of reserved slab memory not holding live payload bytes
+  /// (size-class rounding plus free slots).
+  double fragmentation() const {
+    if (reserved_bytes_ == 0) return 0.0;
+    return 1.0 - (double)live_bytes_ / reserved_bytes_;
+  }
+};
+
+}
+}
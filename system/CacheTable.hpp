@@ -0,0 +1,250 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <limits>
+#include <vector>
+#include <glog/logging.h>
+
+namespace Grappa {
+namespace impl {
+
+/// Open-addressed table holding the cached copies of the coherence protocols.
+///
+/// Entries are stored inline in one preallocated array and never move after
+/// they are claimed, so a reference returned by `find`/`claim` stays valid as
+/// long as the entry is pinned (usedcnt > 0). A separate linear-probed index
+/// maps `GlobalAddress::raw_bits()` to an entry slot; a hit is one probe
+/// sequence over the index plus the entry itself, with no allocation.
+///
+/// Replacement is CLOCK over the unpinned entries only. They sit on an
+/// intrusive ring in the order they were last released; a hit sets the
+/// entry's `referenced` bit, and the hand clears it and moves the entry to
+/// the back, giving it a second chance. `pin` takes an entry off the ring and
+/// `unpin` puts it back, so however many entries in-flight tasks hold, a miss
+/// never looks at them.
+///
+/// E must derive from cache_info_base (it needs `key`, `referenced`,
+/// `usedcnt`, `object` and `size`). Use `pin`/`unpin` rather than touching
+/// `usedcnt` directly.
+template <typename E>
+class CacheTable {
+  struct slot_t {
+    uintptr_t key;
+    uint32_t entry;
+  };
+  struct link_t {
+    uint32_t prev;
+    uint32_t next;
+  };
+  static const uint32_t EMPTY = ~0u;
+
+  std::vector<E> entries_;
+  std::vector<slot_t> index_;
+  // Eviction ring of unpinned entries; links_[capacity] is the sentinel, so
+  // its `next` is the clock hand.
+  std::vector<link_t> links_;
+  size_t mask_;
+  int shift_;
+  // Slots [0, used_) of entries_ have been claimed at least once.
+  size_t used_;
+  // Entries off the ring because some task holds them.
+  size_t pinned_;
+  uint64_t evictions_;
+  uint64_t eviction_scans_;
+  uint64_t max_eviction_scan_;
+  // Returned for lookups that do not want to insert.
+  E stub_;
+
+  uint32_t sentinel() const { return (uint32_t)entries_.size(); }
+  uint32_t slot_of(const E& e) const { return (uint32_t)(&e - entries_.data()); }
+
+  void ring_remove(uint32_t v) {
+    link_t& l = links_[v];
+    links_[l.prev].next = l.next;
+    links_[l.next].prev = l.prev;
+    l.prev = l.next = EMPTY;
+  }
+
+  void ring_push_back(uint32_t v) {
+    uint32_t s = sentinel();
+    uint32_t last = links_[s].prev;
+    links_[v].prev = last;
+    links_[v].next = s;
+    links_[last].next = v;
+    links_[s].prev = v;
+  }
+
+  size_t home(uintptr_t key) const {
+    return (size_t)((key * 0x9E3779B97F4A7C15ULL) >> shift_);
+  }
+
+  size_t locate(uintptr_t key) const {
+    size_t i = home(key);
+    while (index_[i].entry != EMPTY && index_[i].key != key) {
+      i = (i + 1) & mask_;
+    }
+    return i;
+  }
+
+  /// Backward-shift deletion keeps probe sequences short without tombstones.
+  /// Only index slots move; entries stay where they are.
+  void unlink(size_t i) {
+    size_t j = i;
+    while (true) {
+      j = (j + 1) & mask_;
+      if (index_[j].entry == EMPTY) break;
+      size_t h = home(index_[j].key);
+      bool stays = (i <= j) ? (i < h && h <= j) : (i < h || h <= j);
+      if (stays) continue;
+      index_[i] = index_[j];
+      i = j;
+    }
+    index_[i].entry = EMPTY;
+  }
+
+  uint32_t pick_victim() {
+    uint32_t s = sentinel();
+    uint64_t scanned = 0;
+    while (true) {
+      uint32_t v = links_[s].next;
+      if (v == s) {
+        LOG(FATAL) << "All " << entries_.size() << " cache entries are pinned by "
+          << "running tasks; increase --max_cache_number.";
+      }
+      scanned++;
+      ring_remove(v);
+      E& e = entries_[v];
+      if (e.referenced) {
+        // Second chance; every entry is passed over at most once per hit.
+        e.referenced = false;
+        ring_push_back(v);
+        continue;
+      }
+      evictions_++;
+      eviction_scans_ += scanned;
+      if (scanned > max_eviction_scan_) max_eviction_scan_ = scanned;
+      return v;
+    }
+  }
+
+public:
+  CacheTable() : mask_(0), shift_(64), used_(0), pinned_(0), evictions_(0),
+    eviction_scans_(0), max_eviction_scan_(0) {}
+
+  bool initialized() const { return !entries_.empty(); }
+  size_t capacity() const { return entries_.size(); }
+  size_t size() const { return used_; }
+  bool full() const { return used_ == entries_.size(); }
+  /// Number of entries pinned by at least one task.
+  size_t pinned() const { return pinned_; }
+
+  /// Allocate room for `capacity` entries. Drops all existing entries.
+  void init(size_t capacity) {
+    CHECK_GT(capacity, 0) << "cache capacity must be positive";
+    CHECK_LT(capacity, (size_t)EMPTY);
+    size_t slots = 1;
+    int bits = 0;
+    // Keep the index at most half full.
+    while (slots < 2 * capacity) { slots <<= 1; bits++; }
+    entries_.assign(capacity, E());
+    index_.assign(slots, slot_t{0, EMPTY});
+    links_.assign(capacity + 1, link_t{EMPTY, EMPTY});
+    links_[capacity].prev = links_[capacity].next = (uint32_t)capacity;
+    mask_ = slots - 1;
+    shift_ = 64 - bits;
+    used_ = 0;
+    pinned_ = 0;
+  }
+
+  /// Forget all entries; payloads must have been released by the caller.
+  void clear() {
+    if (!initialized()) return;
+    init(entries_.size());
+  }
+
+  /// Return the entry for `key`, or nullptr if it is not cached.
+  E* find(uintptr_t key) {
+    E* e = peek(key);
+    if (e != nullptr) e->referenced = true;
+    return e;
+  }
+
+  /// Like find, but does not count as a use of the entry.
+  E* peek(uintptr_t key) {
+    if (!initialized()) return nullptr;
+    size_t i = locate(key);
+    if (index_[i].entry == EMPTY) return nullptr;
+    return &entries_[index_[i].entry];
+  }
+
+  E& stub() { return stub_; }
+
+  /// Hold `e` in place; pinned entries are never evicted.
+  void pin(E& e) {
+    CHECK_LT(e.usedcnt, std::numeric_limits<decltype(e.usedcnt)>::max())
+      << "too many tasks hold one cache entry";
+    if (e.usedcnt++ == 0 && &e != &stub_) {
+      ring_remove(slot_of(e));
+      pinned_++;
+    }
+  }
+
+  void unpin(E& e) {
+    DCHECK_GT(e.usedcnt, 0);
+    if (--e.usedcnt == 0 && &e != &stub_) {
+      ring_push_back(slot_of(e));
+      pinned_--;
+    }
+  }
+
+  /// Number of evictions, and how many ring entries they looked at in total
+  /// and at most; the ratio is the average scan length of a miss.
+  uint64_t evictions() const { return evictions_; }
+  uint64_t eviction_scans() const { return eviction_scans_; }
+  uint64_t max_eviction_scan() const { return max_eviction_scan_; }
+
+  /// Make room for `key` (which must not be present) and return its entry,
+  /// reset to a default-constructed E and unpinned. If a victim had to be
+  /// evicted, its payload is handed back through `old_object`/`old_size`
+  /// so the caller can recycle or free it, along with its key through
+  /// `old_key` if given; otherwise `*old_object` is null.
+  E& claim(uintptr_t key, void** old_object, size_t* old_size,
+      uintptr_t* old_key = nullptr) {
+    CHECK(initialized());
+    uint32_t slot;
+    *old_object = nullptr;
+    *old_size = 0;
+    if (!full()) {
+      slot = used_++;
+    } else {
+      slot = pick_victim();
+      E& victim = entries_[slot];
+      *old_object = victim.object;
+      *old_size = victim.size;
+      if (old_key != nullptr) *old_key = victim.key;
+      unlink(locate(victim.key));
+    }
+    size_t i = locate(key);
+    CHECK_EQ(index_[i].entry, EMPTY) << "key " << (void*)key << " already cached";
+    index_[i].key = key;
+    index_[i].entry = slot;
+
+    E& e = entries_[slot];
+    e = E();
+    e.key = key;
+    e.referenced = true;
+    ring_push_back(slot);
+    return e;
+  }
+
+  /// Apply f to every claimed entry.
+  template <typename F>
+  void for_each(F f) {
+    for (size_t i = 0; i < used_; i++) {
+      f(entries_[i]);
+    }
+  }
+};
+
+}
+}
@@ -0,0 +1,307 @@
+////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010-2015, University of Washington and Battelle
+// Memorial Institute.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//     * Redistributions of source code must retain the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer.
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials
+//       provided with the distribution.
+//     * Neither the name of the University of Washington, Battelle
+//       Memorial Institute, or the names of their contributors may be
+//       used to endorse or promote products derived from this
+//       software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// UNIVERSITY OF WASHINGTON OR BATTELLE MEMORIAL INSTITUTE BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+////////////////////////////////////////////////////////////////////////
+/// Offline replay of a -delegate_trace under each coherence protocol.
+///
+/// Merges the per-core trace files by issue time and runs them, on one
+/// core, through a model of every configuration asked for: the vanilla
+/// protocol, Tardis for each lease and cache size, and WI for each cache
+/// size. The caches are the runtime's own CacheTable, the sharer sets its
+/// SharerSet and the Tardis leases come from -tardis_lease_policy, so
+/// replacement and lease growth behave as in a real run; network timing,
+/// batching and the optional Tardis features are not modelled.
+///
+/// Example (trace YCSB on the cluster once, then tune on a laptop):
+///   grappa_srun -n4 -- ycsb.exe --delegate_trace=/tmp/ycsb
+///   grappa_run -n1 -p1 -- CoherenceSim.exe --sim_trace=/tmp/ycsb \
+///     --sim_leases=10,50,200 --sim_cache_sizes=1000,25000
+
+#include "Grappa.hpp"
+#include "DelegateTrace.hpp"
+
+#include <sstream>
+#include <unordered_map>
+
+DEFINE_string( sim_trace, "", "Prefix of the trace files (-delegate_trace of the traced run)" );
+DEFINE_string( sim_protocols, "vanilla,tardis,wi", "Protocols to replay" );
+DEFINE_string( sim_leases, "200", "Tardis leases to try (at most 255: leases are kept in 8 bits)" );
+DEFINE_string( sim_cache_sizes, "25000", "Cache capacities (max_cache_number) to try" );
+
+using namespace Grappa;
+using impl::trace_record;
+
+/// A traced operation and the core that issued it.
+struct SimOp {
+  uint64_t address;
+  uint64_t time;
+  uint32_t size;
+  Core core;
+  Core owner;
+  impl::TraceOp op;
+};
+
+/// Modelled message sizes: a request carries an address, a clock and a
+/// reply address; a reply or an ack carries two timestamps. Object bytes
+/// are added on top.
+static const size_t REQUEST_BYTES = 24;
+static const size_t REPLY_BYTES = 16;
+
+struct SimResult {
+  uint64_t remote_reads = 0;
+  uint64_t hits = 0;
+  uint64_t expired = 0;
+  uint64_t messages = 0;
+  uint64_t bytes = 0;
+  uint64_t invalidations = 0;
+  uint64_t useless_invalidations = 0;
+
+  void round_trip(size_t request_payload, size_t reply_payload) {
+    messages += 2;
+    bytes += REQUEST_BYTES + request_payload + REPLY_BYTES + reply_payload;
+  }
+};
+
+/// Return the entry for `key` in `cache`, claiming one if it is missing.
+template <typename E>
+static E& lookup(impl::CacheTable<E>& cache, uintptr_t key, bool* found) {
+  E* e = cache.find(key);
+  *found = e != nullptr;
+  if (e != nullptr) return *e;
+  void* old_object;
+  size_t old_size;
+  return cache.claim(key, &old_object, &old_size);
+}
+
+static SimResult run_vanilla(const std::vector<SimOp>& trace) {
+  SimResult r;
+  for (auto& t : trace) {
+    if (t.owner == t.core) continue;
+    if (t.op == impl::TraceOp::Read) {
+      r.remote_reads++;
+      r.round_trip(0, t.size);
+    } else {
+      r.round_trip(t.size, 0);
+    }
+  }
+  return r;
+}
+
+/// Tardis as __tardis_read and __tardis_write do it, with the full refetch
+/// of an expired copy.
+static SimResult run_tardis(const std::vector<SimOp>& trace, Core cores,
+    size_t cache_size) {
+  SimResult r;
+  std::vector<impl::CacheTable<tardis_c_t>> caches(cores);
+  for (auto& c : caches) c.init(cache_size);
+  std::vector<timestamp_t> pts(cores, 0);
+  std::unordered_map<uintptr_t, tardis_o_t> owner;
+
+  for (auto& t : trace) {
+    Core core = t.core;
+    auto& o = owner[t.address];
+    timestamp_t& mypts = pts[core];
+    if (t.op == impl::TraceOp::Read) {
+      if (t.owner == core) {
+        mypts = std::max<timestamp_t>(mypts, o.wts);
+        o.rts = std::max<timestamp_t>(o.rts, mypts);
+        continue;
+      }
+      r.remote_reads++;
+      bool found;
+      auto& e = lookup(caches[core], t.address, &found);
+      if (found && mypts <= e.rts) {
+        r.hits++;
+        mypts = std::max<timestamp_t>(mypts, e.wts);
+        continue;
+      }
+      if (found) r.expired++;
+      impl::tardis_lease_policy().grant(o);
+      o.rts = std::max<timestamp_t>(std::max<timestamp_t>(o.rts, o.wts + o.lease),
+          mypts + o.lease);
+      e.wts = o.wts;
+      e.rts = o.rts;
+      mypts = std::max<timestamp_t>(mypts, o.wts);
+      r.round_trip(0, t.size);
+    } else {
+      impl::tardis_lease_policy().revoke(o);
+      timestamp_t ts = std::max<timestamp_t>(mypts, o.rts + 1);
+      mypts = o.wts = o.rts = ts;
+      if (t.owner == core) continue;
+      bool found;
+      auto& e = lookup(caches[core], t.address, &found);
+      e.wts = e.rts = ts;
+      r.round_trip(t.size, 0);
+    }
+  }
+  return r;
+}
+
+/// Write invalidation as __wi_read and __wi_write do it: a remote write
+/// locks the object and collects its copyset, invalidates every other
+/// copy, then unlocks it keeping its own. Evicted copies stay in their
+/// owner's copyset and draw useless invalidations, as in the runtime.
+static SimResult run_wi(const std::vector<SimOp>& trace, Core cores,
+    size_t cache_size) {
+  SimResult r;
+  std::vector<impl::CacheTable<wi_c_t>> caches(cores);
+  for (auto& c : caches) c.init(cache_size);
+  std::unordered_map<uintptr_t, impl::SharerSet> copysets;
+
+  for (auto& t : trace) {
+    Core core = t.core;
+    auto& copyset = copysets[t.address];
+    if (t.op == impl::TraceOp::Read) {
+      if (t.owner == core) continue;
+      r.remote_reads++;
+      bool found;
+      auto& e = lookup(caches[core], t.address, &found);
+      if (found && e.valid) {
+        r.hits++;
+        continue;
+      }
+      e.valid = true;
+      copyset.add(core);
+      r.round_trip(0, t.size);
+    } else {
+      copyset.for_each(cores, [&](Core c) {
+        if (c == core) return;
+        r.invalidations++;
+        r.round_trip(0, 0);
+        auto* e = caches[c].peek(t.address);
+        if (e == nullptr || !e->valid) {
+          r.useless_invalidations++;
+        } else {
+          e->valid = false;
+        }
+      });
+      copyset.clear();
+      if (t.owner == core) continue;
+      // Lock and fetch the copyset, then write and unlock.
+      r.round_trip(0, REPLY_BYTES);
+      r.round_trip(t.size, 0);
+      copyset.add(core);
+      bool found;
+      lookup(caches[core], t.address, &found).valid = true;
+    }
+  }
+  return r;
+}
+
+template <typename T>
+static std::vector<T> parse_list(const std::string& s) {
+  std::vector<T> v;
+  std::stringstream ss(s);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    if (item.empty()) continue;
+    std::stringstream is(item);
+    T x;
+    is >> x;
+    v.push_back(x);
+  }
+  return v;
+}
+
+/// All the operations of the trace at `prefix`, in issue order.
+static std::vector<SimOp> load_trace(const std::string& prefix, Core* cores) {
+  std::vector<SimOp> trace;
+  *cores = 1;
+  for (Core c = 0; c < *cores; c++) {
+    impl::trace_header h;
+    std::vector<trace_record> records;
+    std::string path = prefix + "." + std::to_string(c);
+    CHECK(impl::read_trace(path.c_str(), &h, &records)) << "cannot read trace " << path;
+    *cores = h.cores;
+    for (auto& r : records) {
+      SimOp op = { r.address, r.time, r.size, c, r.owner, r.op };
+      trace.push_back(op);
+    }
+  }
+  // Clocks of cores on one node agree; across nodes this order is only
+  // approximate.
+  std::stable_sort(trace.begin(), trace.end(), [](const SimOp& a, const SimOp& b) {
+    return a.time < b.time;
+  });
+  return trace;
+}
+
+int main(int argc, char* argv[]) {
+  Grappa::init(&argc, &argv);
+  Grappa::run([]{
+    CHECK(!FLAGS_sim_trace.empty()) << "give the trace to replay with --sim_trace";
+    Core cores;
+    auto trace = load_trace(FLAGS_sim_trace, &cores);
+    LOG(INFO) << "Replaying " << trace.size() << " operations of " << cores << " cores";
+
+    auto report = [&](const std::string& config, const SimResult& r, double seconds) {
+      LOG(INFO) << config
+        << ": hit rate " << (r.remote_reads ? (double)r.hits / r.remote_reads : 0.0)
+        << ", expired " << r.expired
+        << ", messages " << r.messages
+        << ", bytes " << r.bytes
+        << ", invalidations " << r.invalidations
+        << " (" << r.useless_invalidations << " useless)"
+        << ", simulated in " << seconds << " s";
+    };
+
+    auto leases = parse_list<int>(FLAGS_sim_leases);
+    auto cache_sizes = parse_list<size_t>(FLAGS_sim_cache_sizes);
+    for (auto& proto : parse_list<std::string>(FLAGS_sim_protocols)) {
+      if (proto == "vanilla") {
+        double start = walltime();
+        auto r = run_vanilla(trace);
+        report("vanilla", r, walltime() - start);
+      } else if (proto == "tardis") {
+        for (int lease : leases) {
+          CHECK(lease > 0 && lease <= 255) << "lease " << lease << " out of range";
+          FLAGS_lease = lease;
+          for (size_t size : cache_sizes) {
+            double start = walltime();
+            auto r = run_tardis(trace, cores, size);
+            report("tardis lease=" + std::to_string(lease) + " cache=" + std::to_string(size),
+                r, walltime() - start);
+          }
+        }
+      } else if (proto == "wi") {
+        for (size_t size : cache_sizes) {
+          double start = walltime();
+          auto r = run_wi(trace, cores, size);
+          report("wi cache=" + std::to_string(size), r, walltime() - start);
+        }
+      } else {
+        LOG(FATAL) << "unknown protocol " << proto;
+      }
+    }
+  });
+  Grappa::finalize();
+}
@@ -49,6 +49,7 @@ extern HeapLeakChecker * Grappa_heapchecker;
 
 #ifndef COMMUNICATOR_TEST
 #include "Metrics.hpp"
+#include "GlobalHeapWindow.hpp"
 #endif
 
 DEFINE_int64( log2_concurrent_receives, 7, "How many receive requests do we keep active at a time?" );
@@ -474,6 +475,9 @@ void Communicator::process_collectives() {
 void Communicator::poll( unsigned int max_receives ) {
   process_received_buffers();
   process_collectives();
+#ifndef COMMUNICATOR_TEST
+  Grappa::impl::global_heap_window.poll();
+#endif
   garbage_collect();
 }
 
@@ -35,14 +35,23 @@
 #include "Delegate.hpp"
 #include "Timestamp.hpp"
 #include "common.hpp"
+#include "CallbackMetric.hpp"
+#include "Collective.hpp"
 
 #include <cassert>
+#include <functional>
 #include <numeric>
+#include <unordered_map>
 #include <limits>
+#include <string>
 
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 
+DEFINE_string(delegate_trace, "",
+    "Log every delegate read and write to <prefix>.<core>, for replay by "
+    "CoherenceSim.exe (empty: no trace).");
+
 GRAPPA_DEFINE_METRIC(HistogramMetric, delegate_op_latency_histogram, 0);
 
 GRAPPA_DEFINE_METRIC(SummarizingMetric<uint64_t>, flat_combiner_fetch_and_add_amount, 0);
@@ -58,6 +67,66 @@ GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, delegate_cache_miss, 0.0);
 GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, delegate_inv, 0.0);
 GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, delegate_useless_inv, 0.0);
 GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, delegate_cache_expired, 0.0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, delegate_batched_rpcs, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, tardis_bg_renewal_queued, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, tardis_bg_renewed, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, tardis_bg_renewal_stale, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, tardis_renewal_renewed, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, tardis_renewal_failed, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, tardis_renewal_refetched, 0);
+// Write-invalidation requests parked at the owner while the object was
+// locked, and requests that had to be sent again because of a lock.
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, delegate_wi_lock_waits, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, delegate_wi_lock_retries, 0);
+// Tardis writes that had to move past a lease still held by readers; the
+// price a writer pays for long leases (Tardis never aborts a write).
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, tardis_write_lease_jumps, 0);
+// Writes held back by a ReadMostly epoch until it ended.
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, delegate_epoch_writes, 0);
+// read_async() calls served synchronously because half the cache was
+// already pinned by reads in flight.
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, delegate_async_read_syncs, 0);
+// Tardis writes absorbed by a buffered write to the same address, and
+// batches of buffered writes published (-tardis_write_buffer).
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, tardis_write_buffer_coalesced, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, tardis_write_buffer_flushes, 0);
+// Private-cache misses (or expired copies) served by the locale tier
+// (-tardis_locale_cache), and those that went on to the owner.
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, tardis_locale_cache_hit, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, tardis_locale_cache_miss, 0);
+
+// Hot objects (-tardis_hot_sample).
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, tardis_hot_promotions, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, tardis_hot_demotions, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, tardis_hot_pushes, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, tardis_hot_push_batches, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, tardis_hot_push_applied, 0);
+
+// Refetches served together at the owner (-tardis_owner_batch): drains,
+// requests, distinct objects and reply messages.
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, tardis_owner_batches, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, tardis_owner_batched_reads, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, tardis_owner_batch_keys, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, tardis_owner_batch_replies, 0);
+
+// Fraction of cached reads that found their copy expired.
+GRAPPA_DEFINE_METRIC(CallbackMetric<double>, delegate_cache_expired_rate, []{
+  uint64_t total = delegate_cache_hit.value() + delegate_cache_miss.value()
+    + delegate_cache_expired.value();
+  return total == 0 ? 0.0 : (double)delegate_cache_expired.value() / total;
+});
+
+// Hit rate of each tier: the core's private cache, and the locale cache
+// behind it.
+GRAPPA_DEFINE_METRIC(CallbackMetric<double>, delegate_cache_hit_rate, []{
+  uint64_t total = delegate_cache_hit.value() + delegate_cache_miss.value()
+    + delegate_cache_expired.value();
+  return total == 0 ? 0.0 : (double)delegate_cache_hit.value() / total;
+});
+GRAPPA_DEFINE_METRIC(CallbackMetric<double>, tardis_locale_cache_hit_rate, []{
+  uint64_t total = tardis_locale_cache_hit.value() + tardis_locale_cache_miss.value();
+  return total == 0 ? 0.0 : (double)tardis_locale_cache_hit.value() / total;
+});
 
 GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, delegate_ops, 0);
 GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, delegate_targets, 0);
@@ -69,3 +138,489 @@ GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, delegate_cmpswaps, 0);
 GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, delegate_cmpswap_targets, 0);
 GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, delegate_fetchadds, 0);
 GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, delegate_fetchadd_targets, 0);
+
+namespace Grappa {
+namespace impl {
+
+/// Keys waiting for background renewal, and whether a worker is draining them.
+static std::vector<uintptr_t> renewal_queue;
+static bool renewal_worker_running = false;
+
+/// Renew the leases of everything in renewal_queue, one batched RPC per
+/// owner core. Only the wts-match fast path is taken: a copy that has been
+/// overwritten at the owner is left to expire and be refetched on demand.
+static void renewal_worker() {
+  using delegate::batch_size;
+  while (!renewal_queue.empty()) {
+    std::vector<uintptr_t> keys;
+    keys.swap(renewal_queue);
+
+    std::vector<GlobalAddress<char>> targets;
+    std::vector<tardis_c_t*> entries;
+    std::vector<timestamp_t> wts;
+    for (auto key : keys) {
+      auto* c = GlobalCacheData::tardis_cache.peek(key);
+      // Evicted since it was queued.
+      if (c == nullptr || !c->renewing) continue;
+      // A reader is refetching it right now.
+      if (c->refcnt > 0) {
+        c->renewing = false;
+        continue;
+      }
+      GlobalCacheData::tardis_cache.pin(*c);
+      targets.push_back(GlobalAddress<char>::Raw(key & ~BLOCK_KEY_BIT));
+      entries.push_back(c);
+      wts.push_back(c->wts);
+    }
+
+    std::vector<size_t> order(targets.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = i;
+    std::sort(order.begin(), order.end(), [&targets](size_t a, size_t b) {
+      return targets[a].core() < targets[b].core();
+    });
+
+    timestamp_t pts = Grappa::mypts();
+    delegate::__for_each_owner_batch(targets.data(), order,
+        [&](Core dest, const size_t* idx, size_t k) {
+      struct request_t {
+        GlobalAddress<char> a[batch_size<char>()];
+        timestamp_t wts[batch_size<char>()];
+      } req;
+      struct reply_t { timestamp_t rts[batch_size<char>()]; };
+      for (size_t j = 0; j < k; j++) {
+        req.a[j] = targets[idx[j]];
+        req.wts[j] = wts[idx[j]];
+      }
+      auto rep = delegate::call(dest, [req, k, pts] {
+        reply_t rep;
+        for (size_t j = 0; j < k; j++) {
+          rep.rts[j] = delegate::__tardis_owner_renew(req.a[j], req.wts[j], pts, false);
+        }
+        return rep;
+      });
+      for (size_t j = 0; j < k; j++) {
+        auto& c = *entries[idx[j]];
+        // The copy may have been refetched or overwritten meanwhile.
+        if (rep.rts[j] != (timestamp_t)~0L && c.wts == wts[idx[j]]) {
+          c.rts = std::max<timestamp_t>(c.rts, rep.rts[j]);
+          tardis_locale_publish(c);
+          tardis_bg_renewed++;
+        } else {
+          tardis_bg_renewal_stale++;
+        }
+        c.renewing = false;
+        GlobalCacheData::tardis_cache.unpin(c);
+      }
+    });
+  }
+  renewal_worker_running = false;
+}
+
+EpochMode epoch_mode = EpochMode::Normal;
+std::vector<buffered_write> epoch_writes;
+std::vector<char> epoch_values;
+
+void tardis_renew_in_background(uintptr_t key) {
+  renewal_queue.push_back(key);
+  if (!renewal_worker_running) {
+    renewal_worker_running = true;
+    Grappa::spawn([]{ renewal_worker(); });
+  }
+}
+
+/// Publish buffered writes with one write_many per type; program order is
+/// kept within a type. Sorts a copy: the buffer's index into `writes` must
+/// stay valid while the batch is in flight.
+static void publish_writes(const std::vector<buffered_write>& buffered,
+    const std::vector<char>& values) {
+  std::vector<buffered_write> writes(buffered);
+  std::less<buffered_write::publish_fn> before;
+  std::stable_sort(writes.begin(), writes.end(),
+      [&before](const buffered_write& a, const buffered_write& b) {
+    return before(a.publish, b.publish);
+  });
+  for (size_t i = 0, j; i < writes.size(); i = j) {
+    for (j = i + 1; j < writes.size() && writes[j].publish == writes[i].publish; j++);
+    writes[i].publish(&writes[i], j - i, values.data());
+  }
+}
+
+/// Remote Tardis writes held back under -tardis_write_buffer; `index` maps
+/// an address to its (single, coalesced) entry in `writes`.
+struct write_buffer {
+  std::vector<buffered_write> writes;
+  std::vector<char> values;
+  std::unordered_map<uintptr_t, size_t> index;
+
+  const buffered_write* find(uintptr_t target) const {
+    auto it = index.find(target);
+    return it == index.end() ? nullptr : &writes[it->second];
+  }
+  void clear() {
+    writes.clear();
+    values.clear();
+    index.clear();
+  }
+};
+
+/// Writes still to be published, and the batch being published right now.
+static write_buffer pending_writes, publishing_writes;
+/// Publish the pending writes once the clock passes this, or once the wall
+/// clock passes the second one, whichever comes first.
+static timestamp_t write_buffer_deadline;
+static double write_buffer_walltime_deadline;
+static bool write_publisher_running = false;
+static ConditionVariable writes_published;
+size_t buffered_tardis_writes = 0;
+
+/// Publish pending writes, a buffer-full at a time, until there are none.
+/// Only one publisher runs at a time, so batches reach each owner in order.
+static void write_publisher() {
+  while (!pending_writes.writes.empty()) {
+    std::swap(pending_writes, publishing_writes);
+    tardis_write_buffer_flushes++;
+    publish_writes(publishing_writes.writes, publishing_writes.values);
+    buffered_tardis_writes -= publishing_writes.writes.size();
+    publishing_writes.clear();
+  }
+  write_publisher_running = false;
+  broadcast(&writes_published);
+}
+
+static void start_write_publisher() {
+  if (write_publisher_running) return;
+  write_publisher_running = true;
+  Grappa::spawn([]{ write_publisher(); });
+}
+
+void buffer_tardis_write(buffered_write::publish_fn publish, uintptr_t target,
+    const void* value, size_t size) {
+  auto* w = pending_writes.find(target);
+  if (w != nullptr && w->publish == publish) {
+    tardis_write_buffer_coalesced++;
+    memcpy(&pending_writes.values[w->offset], value, size);
+    return;
+  }
+  if (w != nullptr) {
+    // The same address written as another type: keep the two in order.
+    delegate::flush_writes();
+  }
+  if (pending_writes.writes.empty()) {
+    write_buffer_deadline = Grappa::mypts() + FLAGS_lease;
+    write_buffer_walltime_deadline = Grappa::walltime() + FLAGS_tardis_write_buffer_us * 1e-6;
+  }
+  buffered_write b;
+  b.publish = publish;
+  b.target = target;
+  b.offset = pending_writes.values.size();
+  b.size = size;
+  pending_writes.values.resize(b.offset + size);
+  memcpy(&pending_writes.values[b.offset], value, size);
+  pending_writes.index[target] = pending_writes.writes.size();
+  pending_writes.writes.push_back(b);
+  buffered_tardis_writes++;
+
+  if (pending_writes.writes.size() >= (size_t)FLAGS_tardis_write_buffer) {
+    start_write_publisher();
+  } else {
+    check_tardis_write_buffer();
+  }
+}
+
+bool read_buffered_tardis_write(uintptr_t target, void* out, size_t size) {
+  const write_buffer* buffers[] = { &pending_writes, &publishing_writes };
+  for (auto* b : buffers) {
+    auto* w = b->find(target);
+    if (w == nullptr) continue;
+    if (w->size != size) {
+      // Read as another type than written; let the owner sort it out.
+      delegate::flush_writes();
+      return false;
+    }
+    memcpy(out, &b->values[w->offset], size);
+    return true;
+  }
+  return false;
+}
+
+bool tardis_write_buffered_in(uintptr_t target, size_t size) {
+  const write_buffer* buffers[] = { &pending_writes, &publishing_writes };
+  for (auto* b : buffers) {
+    for (auto& w : b->writes) {
+      if (w.target < target + size && target < w.target + w.size) return true;
+    }
+  }
+  return false;
+}
+
+bool tardis_locale_fill(tardis_c_t& mycache) {
+  if (FLAGS_tardis_locale_cache == 0) return false;
+  timestamp_t wts, rts;
+  if (!GlobalCacheData::shared_locale_cache().read(mycache.key, mycache.size,
+        Grappa::mypts(), mycache.object, &wts, &rts)) {
+    tardis_locale_cache_miss++;
+    return false;
+  }
+  tardis_locale_cache_hit++;
+  mycache.wts = wts;
+  mycache.rts = rts;
+  Grappa::mypts() = std::max<timestamp_t>(Grappa::mypts(), wts);
+  return true;
+}
+
+void tardis_locale_publish(const tardis_c_t& mycache) {
+  if (FLAGS_tardis_locale_cache == 0) return;
+  GlobalCacheData::shared_locale_cache().publish(mycache.key, mycache.object,
+      mycache.size, mycache.wts, mycache.rts);
+}
+
+/// Sampled reads seen by this owner, and in the current hot-key window.
+static uint64_t hot_reads = 0;
+static uint64_t hot_window_samples = 0;
+static unsigned char hot_window = 0;
+
+/// Close a hot-key window: objects read less than the threshold during it
+/// go back to normal leases.
+static void end_hot_window() {
+  hot_window++;
+  hot_window_samples = 0;
+  uint64_t keep = (uint64_t)FLAGS_tardis_hot_threshold * FLAGS_tardis_hot_sample;
+  auto& hot = GlobalCacheData::tardis_hot_keys;
+  for (auto it = hot.begin(); it != hot.end(); ) {
+    if (it->second.reads < keep) {
+      VLOG(2) << "demoting hot block " << (void*)it->first;
+      it->second.owner->hot = false;
+      tardis_hot_demotions++;
+      it = hot.erase(it);
+    } else {
+      it->second.reads = 0;
+      ++it;
+    }
+  }
+}
+
+/// Owner metadata is kept per block, so objects are promoted and tracked
+/// by the block holding them.
+static inline uintptr_t hot_block(uintptr_t key) {
+  return key - key % block_size;
+}
+
+bool tardis_hot_read(tardis_o_t& o, uintptr_t key, Core reader) {
+  bool sampled = ++hot_reads % FLAGS_tardis_hot_sample == 0;
+  if (sampled && ++hot_window_samples >= (uint64_t)FLAGS_tardis_hot_window) {
+    end_hot_window();
+  }
+  if (o.hot) {
+    auto it = GlobalCacheData::tardis_hot_keys.find(hot_block(key));
+    CHECK(it != GlobalCacheData::tardis_hot_keys.end()) << "hot block " << (void*)key << " not tracked";
+    auto& h = it->second;
+    if (reader != Grappa::mycore()) h.readers.add(reader);
+    h.reads++;
+    return true;
+  }
+  if (!sampled) return false;
+  if (o.heat_window != hot_window) {
+    o.heat_window = hot_window;
+    o.heat = 0;
+  }
+  if (o.heat < 255) o.heat++;
+  if (o.heat < FLAGS_tardis_hot_threshold) return false;
+
+  VLOG(2) << "promoting hot block " << (void*)hot_block(key);
+  o.hot = true;
+  tardis_hot_key h;
+  h.owner = &o;
+  if (reader != Grappa::mycore()) h.readers.add(reader);
+  h.reads = 0;
+  GlobalCacheData::tardis_hot_keys[hot_block(key)] = h;
+  tardis_hot_promotions++;
+  return true;
+}
+
+/// Pushed versions travel in fixed-size batches, one message per reader.
+struct hot_push_header {
+  uintptr_t key;
+  timestamp_t wts, rts;
+  uint32_t size;
+};
+
+template <size_t N>
+struct hot_push_batch {
+  uint32_t used;
+  char bytes[N];
+};
+
+/// Reader side: install pushed versions over older cached copies. Copies
+/// not cached, pinned by a running task or already newer are left alone.
+static void apply_hot_pushes(const char* bytes, uint32_t used) {
+  for (uint32_t off = 0; off < used; ) {
+    hot_push_header h;
+    memcpy(&h, bytes + off, sizeof(h));
+    const char* value = bytes + off + sizeof(h);
+    off += sizeof(h) + h.size;
+    auto* c = GlobalCacheData::tardis_cache.peek(h.key);
+    if (c == nullptr || c->usedcnt > 0 || c->object == nullptr ||
+        c->size != h.size || c->wts >= h.wts) {
+      continue;
+    }
+    memcpy(c->object, value, h.size);
+    c->wts = h.wts;
+    c->rts = h.rts;
+    tardis_locale_publish(*c);
+    tardis_hot_push_applied++;
+  }
+}
+
+template <size_t N>
+static void send_hot_push_batch(Core dest, const std::vector<char>& bytes) {
+  hot_push_batch<N> b;
+  b.used = bytes.size();
+  memcpy(b.bytes, bytes.data(), bytes.size());
+  send_heap_message(dest, [b] { apply_hot_pushes(b.bytes, b.used); });
+}
+
+static const size_t HOT_PUSH_BYTES = 2048;
+/// Versions waiting to be pushed, by destination core.
+static std::unordered_map<Core, std::vector<char>> hot_push_queue;
+static bool hot_pusher_running = false;
+
+static void send_hot_pushes(Core dest, std::vector<char>& bytes) {
+  tardis_hot_push_batches++;
+  if (bytes.size() <= 256) {
+    send_hot_push_batch<256>(dest, bytes);
+  } else if (bytes.size() <= 1024) {
+    send_hot_push_batch<1024>(dest, bytes);
+  } else {
+    send_hot_push_batch<HOT_PUSH_BYTES>(dest, bytes);
+  }
+  bytes.clear();
+}
+
+void tardis_hot_push(tardis_o_t& o, uintptr_t key, const void* value, size_t size) {
+  hot_push_header h;
+  if (sizeof(h) + size > HOT_PUSH_BYTES) return;
+  // Readers keep the pushed version for a hot lease, so it is not
+  // overwritten before then.
+  o.rts = std::max<timestamp_t>(o.rts, o.wts + FLAGS_tardis_hot_lease);
+  h.key = key;
+  h.wts = o.wts;
+  h.rts = o.rts;
+  h.size = size;
+  auto it = GlobalCacheData::tardis_hot_keys.find(hot_block(key));
+  if (it == GlobalCacheData::tardis_hot_keys.end()) return;
+  it->second.readers.for_each(Grappa::cores(), [&](Core c) {
+    auto& q = hot_push_queue[c];
+    if (q.size() + sizeof(h) + size > HOT_PUSH_BYTES) send_hot_pushes(c, q);
+    size_t off = q.size();
+    q.resize(off + sizeof(h) + size);
+    memcpy(&q[off], &h, sizeof(h));
+    memcpy(&q[off + sizeof(h)], value, size);
+    tardis_hot_pushes++;
+  });
+  // Writes made before the pusher gets to run share its batches.
+  if (!hot_pusher_running && !hot_push_queue.empty()) {
+    hot_pusher_running = true;
+    Grappa::spawn([] {
+      for (auto& q : hot_push_queue) {
+        if (!q.second.empty()) send_hot_pushes(q.first, q.second);
+      }
+      hot_pusher_running = false;
+    });
+  }
+}
+
+/// This core's trace file, and the records not yet written to it.
+static FILE* trace_file = nullptr;
+static std::vector<trace_record> trace_buffer;
+static const size_t TRACE_BUFFER_RECORDS = 1 << 16;
+
+static void flush_delegate_trace() {
+  if (trace_buffer.empty()) return;
+  size_t n = fwrite(trace_buffer.data(), sizeof(trace_record), trace_buffer.size(), trace_file);
+  PCHECK(n == trace_buffer.size()) << "cannot write delegate trace";
+  trace_buffer.clear();
+}
+
+void start_delegate_trace() {
+  if (FLAGS_delegate_trace.empty() || trace_file != nullptr) return;
+  std::string path = FLAGS_delegate_trace + "." + std::to_string(Grappa::mycore());
+  trace_file = fopen(path.c_str(), "wb");
+  PCHECK(trace_file != nullptr) << "cannot open delegate trace " << path;
+  trace_header h;
+  memcpy(h.magic, TRACE_MAGIC, sizeof(h.magic));
+  h.core = Grappa::mycore();
+  h.cores = Grappa::cores();
+  h.tick_rate = (uint64_t)Grappa::tick_rate;
+  PCHECK(fwrite(&h, sizeof(h), 1, trace_file) == 1) << "cannot write delegate trace";
+  trace_buffer.reserve(TRACE_BUFFER_RECORDS);
+}
+
+void trace_delegate(TraceOp op, uintptr_t address, Core owner, size_t size) {
+  if (trace_file == nullptr) start_delegate_trace();
+  trace_record r;
+  r.address = address;
+  r.time = Grappa::timestamp();
+  r.size = size;
+  r.owner = owner;
+  r.op = op;
+  r.pad = 0;
+  trace_buffer.push_back(r);
+  if (trace_buffer.size() == TRACE_BUFFER_RECORDS) flush_delegate_trace();
+}
+
+void finish_delegate_trace() {
+  if (trace_file == nullptr) return;
+  flush_delegate_trace();
+  fclose(trace_file);
+  trace_file = nullptr;
+}
+
+void check_tardis_write_buffer() {
+  if (!pending_writes.writes.empty() && Grappa::mypts() > write_buffer_deadline) {
+    start_write_publisher();
+  }
+}
+
+void poll_tardis_write_buffer() {
+  if (!pending_writes.writes.empty() && Grappa::walltime() >= write_buffer_walltime_deadline) {
+    start_write_publisher();
+  }
+}
+
+} // namespace impl
+
+namespace delegate {
+
+void flush_writes() {
+  if (impl::buffered_tardis_writes == 0 && !impl::write_publisher_running) return;
+  impl::start_write_publisher();
+  while (impl::write_publisher_running) Grappa::wait(&impl::writes_published);
+}
+
+void begin_epoch(EpochMode mode) {
+  on_all_cores([mode] {
+    CHECK(impl::epoch_mode == EpochMode::Normal) << "delegate epochs do not nest";
+    flush_writes();
+    impl::epoch_mode = mode;
+  });
+}
+
+void end_epoch() {
+  // Nobody may still be buffering once anyone publishes.
+  on_all_cores([] { impl::epoch_mode = EpochMode::Normal; });
+  on_all_cores([] {
+    flush_writes();
+    std::vector<impl::buffered_write> writes;
+    std::vector<char> values;
+    writes.swap(impl::epoch_writes);
+    values.swap(impl::epoch_values);
+    impl::publish_writes(writes, values);
+
+    // A single timestamp bump: every writer's clock is past the versions it
+    // wrote, so moving all clocks to the latest expires every stale copy.
+    Grappa::mypts() = allreduce<timestamp_t,collective_max>(Grappa::mypts());
+  });
+}
+
+} // namespace delegate
+} // namespace Grappa
@@ -44,7 +44,13 @@
 #include "ParallelLoop.hpp"
 #include "Communicator.hpp"
 #include "TardisCache.hpp"
+#include "DelegateTrace.hpp"
 #include <type_traits>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+DECLARE_string(delegate_trace);
 
 GRAPPA_DECLARE_METRIC(SummarizingMetric<uint64_t>, flat_combiner_fetch_and_add_amount);
 GRAPPA_DECLARE_METRIC(SummarizingMetric<double>, delegate_read_latency);
@@ -54,6 +60,31 @@ GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, delegate_cache_miss);
 GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, delegate_inv);
 GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, delegate_useless_inv);
 GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, delegate_cache_expired);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, delegate_batched_rpcs);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, tardis_bg_renewal_queued);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, tardis_bg_renewed);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, tardis_bg_renewal_stale);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, tardis_renewal_renewed);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, tardis_renewal_failed);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, tardis_renewal_refetched);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, delegate_wi_lock_waits);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, delegate_wi_lock_retries);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, tardis_write_lease_jumps);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, delegate_epoch_writes);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, delegate_async_read_syncs);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, tardis_write_buffer_coalesced);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, tardis_write_buffer_flushes);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, tardis_locale_cache_hit);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, tardis_locale_cache_miss);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, tardis_hot_promotions);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, tardis_hot_demotions);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, tardis_hot_pushes);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, tardis_hot_push_batches);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, tardis_hot_push_applied);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, tardis_owner_batches);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, tardis_owner_batched_reads);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, tardis_owner_batch_keys);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, tardis_owner_batch_replies);
 GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, delegate_reads);
 GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, delegate_read_targets);
 GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, delegate_writes);
@@ -68,6 +99,85 @@ namespace Grappa {
     /// @{
     
   namespace impl {
+
+    /// Queue the cached Tardis copy with raw address `key` for background
+    /// lease renewal; defined in Delegate.cpp.
+    void tardis_renew_in_background(uintptr_t key);
+
+    /// Mode of the delegate epoch this core is in; see delegate::begin_epoch.
+    extern EpochMode epoch_mode;
+
+    /// A write held back in a buffer (a ReadMostly epoch's, or the Tardis
+    /// write buffer); its `size` bytes are at `offset` in the buffer's
+    /// values. `publish` writes out `n` consecutive buffered writes that
+    /// share it, and so their type.
+    struct buffered_write {
+      typedef void (*publish_fn)(const buffered_write* w, size_t n, const char* values);
+      publish_fn publish;
+      uintptr_t target;
+      size_t offset;
+      size_t size;
+    };
+    extern std::vector<buffered_write> epoch_writes;
+    extern std::vector<char> epoch_values;
+
+    /// Remote Tardis writes this core has buffered under
+    /// -tardis_write_buffer and not yet published.
+    extern size_t buffered_tardis_writes;
+    /// Buffer a write, coalescing it with a pending one to the same address.
+    void buffer_tardis_write(buffered_write::publish_fn publish, uintptr_t target,
+        const void* value, size_t size);
+    /// Copy out the newest buffered value written to `target`, if any.
+    bool read_buffered_tardis_write(uintptr_t target, void* out, size_t size);
+    /// Whether any buffered write touches the `size` bytes at `target`.
+    bool tardis_write_buffered_in(uintptr_t target, size_t size);
+    /// Start publishing the buffer if its oldest write has outlived a lease.
+    void check_tardis_write_buffer();
+    /// Called by the polling thread: start publishing the buffer if its
+    /// oldest write is older than -tardis_write_buffer_us.
+    void poll_tardis_write_buffer();
+
+    /// With -tardis_locale_cache, refill a copy this core is missing (or
+    /// holds expired) from the locale tier, if another core there has one
+    /// whose lease still covers our clock.
+    bool tardis_locale_fill(tardis_c_t& mycache);
+    /// With -tardis_locale_cache, offer a copy just fetched or renewed to
+    /// the other cores of the locale.
+    void tardis_locale_publish(const tardis_c_t& mycache);
+
+    /// Open this core's -delegate_trace file and write its header, if
+    /// tracing and not done yet. Called at startup, so that every core has
+    /// a file even if it never logs an operation.
+    void start_delegate_trace();
+    /// Append a record of an operation to this core's -delegate_trace file.
+    void trace_delegate(TraceOp op, uintptr_t address, Core owner, size_t size);
+    /// Write out and close the trace file, if one is open.
+    void finish_delegate_trace();
+
+    /// Owner side of -tardis_hot_sample: account for a read of the object
+    /// `key`, with metadata `o`, by `reader`, promoting or demoting objects
+    /// as their heat changes. True if the object is hot; the reader is then
+    /// sent its new versions.
+    bool tardis_hot_read(tardis_o_t& o, uintptr_t key, Core reader);
+    /// Owner side of a write to a hot object: send the new `size`-byte
+    /// version at `value` to the cores that read it.
+    void tardis_hot_push(tardis_o_t& o, uintptr_t key, const void* value, size_t size);
+
+    /// Result of applying an update function to an object, which can be
+    /// shipped back from its owner even when the function returns void.
+    template< typename R >
+    struct update_result {
+      R r;
+      template< typename F, typename T >
+      void apply(const F& f, T& x) { r = f(x); }
+      R get() const { return r; }
+    };
+    template<>
+    struct update_result<void> {
+      template< typename F, typename T >
+      void apply(const F& f, T& x) { f(x); }
+      void get() const {}
+    };
             
     template< SyncMode S, GlobalCompletionEvent * C, typename F >
     struct Specializer {
@@ -123,17 +233,20 @@ namespace Grappa {
               GlobalCompletionEvent * C = &impl::local_gce,
               typename F = decltype(nullptr) >
     auto call(Core dest, F f) -> AUTO_INVOKE((impl::Specializer<S,C,F>::call(dest, f, &F::operator())));
+
+    template< SyncMode S, GlobalCompletionEvent * C, typename T, typename F >
+    static auto __update(GlobalAddress<T> target, F func) -> decltype(func(*target.pointer()));
         
   } // namespace delegate
     
   namespace impl {
     template< SyncMode S, GlobalCompletionEvent * C, typename T, typename R, typename F >
     inline auto call(GlobalAddress<T> t, F func, R (F::*mf)(T&) const) -> decltype(func(*t.pointer())) {
-      return delegate::call<S,C>(t.core(), [t,func]{ return func(*t.pointer()); });
+      return delegate::__update<S,C>(t, func);
     }
     template< SyncMode S, GlobalCompletionEvent * C, typename T, typename R, typename F >
     inline auto call(GlobalAddress<T> t, F func, R (F::*mf)(T*) const) -> decltype(func(t.pointer())) {
-      return delegate::call<S,C>(t.core(), [t,func]{ return func(t.pointer()); });
+      return delegate::__update<S,C>(t, [func](T& x){ return func(&x); });
     }
   }
 
@@ -145,54 +258,6 @@ namespace Grappa {
     }
     enum CacheState { Owner, Hit, Expired, Miss };
 
-    template <typename T>
-    static void bg_renewal(void) {
-#ifdef TARDIS_BG_RENEWAL
-      delegate_bg_renewal++;
-
-      auto info = GlobalAddress<T>::get_expired(Grappa::mypts());
-
-      for (auto iter = info.rbegin(); iter != info.rend(); iter++) {
-        bool valid;
-        GlobalAddress<T> target = *iter;
-        auto& target_cache = GlobalAddress<T>::find_tardis_cache(target, &valid, false);
-        // Cache doesn't exist.
-        if (!valid ||
-            // Cache info is used by others.
-            target_cache.usedcnt > 0 ||
-            // The object is not expired.
-            target_cache.rts >= Grappa::mypts() ||
-            // T is not the correct parameter template of this object.
-            target_cache.size != sizeof(T)) {
-          continue;
-        }
-        target_cache.usedcnt++;
-        GlobalAddress<T>::active_cache(target_cache);
-
-        timestamp_t wts = target_cache.wts;
-        timestamp_t pts = Grappa::mypts();
-
-        auto r = internal_call(target.core(), [target, pts, wts] {
-          auto& owner_ts = GlobalAddress<T>::find_tardis_owner_info(target);
-          owner_ts.rts = std::max<timestamp_t>(std::max<timestamp_t>(
-                owner_ts.rts, owner_ts.wts + LEASE), (pts + LEASE));
-          return impl::rpc_read_result<T>(*target.pointer(), owner_ts);
-        });
-
-        if (target_cache.wts == r.wts) {
-          delegate_bg_fast_path++;
-          target_cache.rts = r.rts;
-        }
-        else {
-          delegate_bg_update++;
-          target_cache.assign(&r.r);
-          target_cache.rts = r.rts;
-          target_cache.wts = r.wts;
-        }
-        GlobalAddress<T>::deactive_cache(target_cache);
-    }
-#endif /* TARDIS_BG_RENEWAL */
-  }
 
     static CacheState try_read_cache(const tardis_c_t& mycache,
         bool valid) {
@@ -200,14 +265,271 @@ namespace Grappa {
         delegate_cache_miss++;
         return CacheState::Miss;
       }
-      if (Grappa::mypts() > mycache.rts) {
+      // Nothing is written back during a ReadMostly epoch, so no copy can
+      // have gone stale.
+      if (impl::epoch_mode != EpochMode::ReadMostly && Grappa::mypts() > mycache.rts) {
         delegate_cache_expired++;
         return CacheState::Expired;
       }
       delegate_cache_hit++;
+      // A version pushed by the owner of a hot block can be newer than our
+      // clock; reading it moves us to its time.
+      if (mycache.wts > Grappa::mypts()) Grappa::mypts() = mycache.wts;
       return CacheState::Hit;
     }
 
+    /// With -tardis_bg_renewal, hand a copy whose lease is within
+    /// -tardis_renewal_margin of expiring to the background renewal worker,
+    /// so that readers keep hitting instead of stalling on Expired.
+    static void __tardis_renew_soon(const tardis_c_t& mycache) {
+      if (!FLAGS_tardis_bg_renewal || mycache.renewing) return;
+      if (impl::epoch_mode == EpochMode::ReadMostly) return;
+      if (mycache.rts - Grappa::mypts() > (timestamp_t)FLAGS_tardis_renewal_margin) return;
+      // The worker renews by address alone, which covers a single block; a
+      // larger copy is renewed by its next reader.
+      if ((mycache.key & ~impl::BLOCK_KEY_BIT) % block_size + mycache.size > block_size) return;
+      mycache.renewing = true;
+      tardis_bg_renewal_queued++;
+      impl::tardis_renew_in_background(mycache.key);
+    }
+
+    /// Extend the lease on an object with metadata `o` past `pts`, by the
+    /// hot-object lease if it is `hot`.
+    static inline void __tardis_owner_grant(tardis_o_t& o, timestamp_t pts, bool hot) {
+      impl::tardis_lease_policy().grant(o);
+      timestamp_t lease = hot ? (timestamp_t)FLAGS_tardis_hot_lease : o.lease;
+      o.rts = std::max<timestamp_t>(std::max<timestamp_t>(o.rts, o.wts + lease),
+          pts + lease);
+    }
+
+    /// Version and lease, into `wts` and `rts`, of the object at `target`
+    /// whose first block has metadata `o`. An object larger than its block
+    /// is as new as the newest of its blocks and is handed out only while
+    /// all of them are leased, so their leases are extended to cover it.
+    template< typename T >
+    static void __tardis_owner_span(GlobalAddress<T> target, const tardis_o_t& o,
+        timestamp_t* wts, timestamp_t* rts) {
+      *wts = o.wts;
+      *rts = o.rts;
+      if (GlobalAddress<T>::object_blocks(target) == 1) return;
+      GlobalAddress<T>::for_each_tardis_owner_info(target, [wts](tardis_o_t& b) {
+        *wts = std::max<timestamp_t>(*wts, b.wts);
+      });
+      *rts = std::max<timestamp_t>(*rts, *wts);
+      GlobalAddress<T>::for_each_tardis_owner_info(target, [rts](tardis_o_t& b) {
+        b.rts = std::max<timestamp_t>(b.rts, *rts);
+      });
+    }
+
+    /// Owner side of a Tardis read by core `reader`: extend the lease on
+    /// `target` past `pts` and return the value together with its
+    /// timestamps. If the requester is refetching an `expired` copy, `wts`
+    /// is that copy's version.
+    template< typename T >
+    static impl::rpc_read_result<T> __tardis_owner_read(GlobalAddress<T> target,
+        Core reader, timestamp_t pts, bool expired = false, timestamp_t wts = 0) {
+      auto& owner_ts = GlobalAddress<T>::find_tardis_owner_info(target);
+      if (expired) owner_ts.observe_expired(owner_ts.wts != wts);
+      bool hot = FLAGS_tardis_hot_sample > 0 &&
+        impl::tardis_hot_read(owner_ts, target.raw_bits(), reader);
+      __tardis_owner_grant(owner_ts, pts, hot);
+      impl::rpc_read_result<T> r(*target.pointer(), owner_ts);
+      __tardis_owner_span(target, owner_ts, &r.wts, &r.rts);
+      return r;
+    }
+
+    /// Most addresses carried by one batched RPC: as many as fit in about
+    /// 2KB of reply, between 1 and 32.
+    template< typename T >
+    constexpr size_t batch_size() {
+      return sizeof(impl::rpc_read_result<T>) >= 2048 ? 1 :
+        (2048 / sizeof(impl::rpc_read_result<T>) > 32 ? 32 :
+         2048 / sizeof(impl::rpc_read_result<T>));
+    }
+
+    /// Requester side of a Tardis refetch: fill the pinned copy `entry`
+    /// from the owner's reply `r`, unpin it and hand the value to `result`.
+    template< typename T >
+    static void __tardis_fill(tardis_c_t* entry, FullEmpty<T>* result,
+        const impl::rpc_read_result<T>& r) {
+      entry->assign(&r.r);
+      entry->rts = r.rts;
+      entry->wts = r.wts;
+      entry->renew_first = r.renewable;
+      Grappa::mypts() = std::max<timestamp_t>(Grappa::mypts(), r.wts);
+      impl::tardis_locale_publish(*entry);
+      GlobalAddress<T>::deactive_cache(*entry);
+      result->writeXF(r.r);
+    }
+
+    /// A refetch queued at the owner (-tardis_owner_batch).
+    template< typename T >
+    struct __tardis_owner_request {
+      GlobalAddress<T> target;
+      timestamp_t pts, wts;
+      bool expired;
+      Core origin;
+      tardis_c_t* entry;
+      FullEmpty<T>* result;
+    };
+
+    /// Refetches of objects of type T waiting at this owner, and whether a
+    /// task to serve them has been spawned.
+    template< typename T >
+    struct __tardis_owner_queue {
+      static std::vector<__tardis_owner_request<T>> pending;
+      static bool scheduled;
+    };
+    template< typename T >
+    std::vector<__tardis_owner_request<T>> __tardis_owner_queue<T>::pending;
+    template< typename T >
+    bool __tardis_owner_queue<T>::scheduled = false;
+
+    /// Serve every queued refetch of T at once. Requests are sorted by
+    /// address so each object's metadata is looked up and its lease granted
+    /// once, past the latest requester's clock; replies go back in one
+    /// message per requesting core and batch.
+    template< typename T >
+    static void __tardis_owner_drain() {
+      typedef __tardis_owner_request<T> request_t;
+      std::vector<request_t> reqs;
+      reqs.swap(__tardis_owner_queue<T>::pending);
+      __tardis_owner_queue<T>::scheduled = false;
+      tardis_owner_batches++;
+      tardis_owner_batched_reads += reqs.size();
+
+      std::stable_sort(reqs.begin(), reqs.end(), [](const request_t& a, const request_t& b) {
+        return a.target.raw_bits() < b.target.raw_bits();
+      });
+      std::vector<impl::rpc_read_result<T>> results(reqs.size());
+      for (size_t i = 0, j; i < reqs.size(); i = j) {
+        auto target = reqs[i].target;
+        auto& owner_ts = GlobalAddress<T>::find_tardis_owner_info(target);
+        timestamp_t pts = 0;
+        bool hot = false;
+        for (j = i; j < reqs.size() && reqs[j].target == target; j++) {
+          auto& q = reqs[j];
+          if (q.expired) owner_ts.observe_expired(owner_ts.wts != q.wts);
+          if (FLAGS_tardis_hot_sample > 0) {
+            hot = impl::tardis_hot_read(owner_ts, target.raw_bits(), q.origin) || hot;
+          }
+          pts = std::max<timestamp_t>(pts, q.pts);
+        }
+        tardis_owner_batch_keys++;
+        __tardis_owner_grant(owner_ts, pts, hot);
+        impl::rpc_read_result<T> r(*target.pointer(), owner_ts);
+        __tardis_owner_span(target, owner_ts, &r.wts, &r.rts);
+        for (size_t k = i; k < j; k++) results[k] = r;
+      }
+
+      std::vector<size_t> order(reqs.size());
+      for (size_t i = 0; i < order.size(); i++) order[i] = i;
+      std::stable_sort(order.begin(), order.end(), [&reqs](size_t a, size_t b) {
+        return reqs[a].origin < reqs[b].origin;
+      });
+      struct reply_t {
+        tardis_c_t* entry[batch_size<T>()];
+        FullEmpty<T>* result[batch_size<T>()];
+        impl::rpc_read_result<T> r[batch_size<T>()];
+      };
+      for (size_t i = 0; i < order.size(); ) {
+        Core origin = reqs[order[i]].origin;
+        reply_t rep;
+        size_t k = 0;
+        for (; i < order.size() && k < batch_size<T>() &&
+            reqs[order[i]].origin == origin; i++, k++) {
+          rep.entry[k] = reqs[order[i]].entry;
+          rep.result[k] = reqs[order[i]].result;
+          rep.r[k] = results[order[i]];
+        }
+        tardis_owner_batch_replies++;
+        send_heap_message(origin, [rep, k] {
+          for (size_t j = 0; j < k; j++) __tardis_fill(rep.entry[j], rep.result[j], rep.r[j]);
+        });
+      }
+    }
+
+    /// Refetch `target` into the pinned copy `entry`, as a reader at `pts`
+    /// (see __tardis_owner_read), without waiting, even for the request to
+    /// be delivered: `result` is written when the reply arrives.
+    template< typename T >
+    static void __tardis_fetch(GlobalAddress<T> target, tardis_c_t* entry,
+        timestamp_t pts, bool expired, timestamp_t wts, FullEmpty<T>* result) {
+      Core origin = Grappa::mycore();
+      if (FLAGS_tardis_owner_batch) {
+        __tardis_owner_request<T> q = { target, pts, wts, expired, origin, entry, result };
+        send_heap_message(target.core(), [q] {
+          delegate_targets++;
+          __tardis_owner_queue<T>::pending.push_back(q);
+          if (!__tardis_owner_queue<T>::scheduled) {
+            // Runs once the rest of the aggregated buffer has been handled,
+            // so its requests are served together.
+            __tardis_owner_queue<T>::scheduled = true;
+            Grappa::spawn([] { __tardis_owner_drain<T>(); });
+          }
+        });
+        return;
+      }
+      send_heap_message(target.core(), [target, pts, expired, wts, origin, entry, result] {
+        delegate_targets++;
+        auto r = __tardis_owner_read(target, origin, pts, expired, wts);
+        send_heap_message(origin, [entry, result, r] {
+          __tardis_fill(entry, result, r);
+        });
+      });
+    }
+
+    /// Owner side of a timestamp-only renewal: if the requester's copy (`wts`)
+    /// is still current, extend its lease past `pts` and return the new rts;
+    /// otherwise return ~0 and leave the lease alone. Only renewals of copies
+    /// that had `expired` feed the write heat; background renewals of live
+    /// copies say nothing about how often the object is overwritten.
+    template< typename T >
+    static timestamp_t __tardis_owner_renew(GlobalAddress<T> target,
+        timestamp_t wts, timestamp_t pts, bool expired) {
+      auto& owner_ts = GlobalAddress<T>::find_tardis_owner_info(target);
+      timestamp_t current, rts;
+      __tardis_owner_span(target, owner_ts, &current, &rts);
+      if (expired) owner_ts.observe_expired(current != wts);
+      if (current != wts) {
+        return (timestamp_t)~0L;
+      }
+      impl::tardis_lease_policy().grant(owner_ts);
+      owner_ts.rts = std::max<timestamp_t>(std::max<timestamp_t>(
+            owner_ts.rts, owner_ts.wts + owner_ts.lease), (pts + owner_ts.lease));
+      __tardis_owner_span(target, owner_ts, &current, &rts);
+      return rts;
+    }
+
+    /// Owner side of a Tardis write or read-modify-write: jump past every
+    /// outstanding lease on any block of the object, apply `update` to it
+    /// and return the new timestamp, which all its blocks take.
+    template< typename T, typename F >
+    static timestamp_t __tardis_owner_update(GlobalAddress<T> target, F update) {
+      auto& owner_ts = GlobalAddress<T>::find_tardis_owner_info(target);
+      impl::tardis_lease_policy().revoke(owner_ts);
+      timestamp_t ts = Grappa::mypts();
+      GlobalAddress<T>::for_each_tardis_owner_info(target, [&ts](tardis_o_t& b) {
+        ts = std::max<timestamp_t>(ts, b.rts + 1);
+      });
+      if (ts > Grappa::mypts()) tardis_write_lease_jumps++;
+      GlobalAddress<T>::for_each_tardis_owner_info(target, [ts](tardis_o_t& b) {
+        b.wts = b.rts = ts;
+      });
+      Grappa::mypts() = ts;
+      update(*target.pointer());
+      if (owner_ts.hot) {
+        impl::tardis_hot_push(owner_ts, target.raw_bits(), target.pointer(), sizeof(T));
+      }
+      return ts;
+    }
+
+    /// Owner side of a Tardis write: store `value` as a new version.
+    template< typename T >
+    static timestamp_t __tardis_owner_write(GlobalAddress<T> target, const T& value) {
+      return __tardis_owner_update(target, [&value](T& x) { x = value; });
+    }
+
     /// Helper that makes it easier to implement custom delegate operations 
     /// specifically on global addresses.
     /// 
@@ -336,19 +658,28 @@ namespace Grappa {
               typename T = decltype(nullptr) >
     static T __tardis_read(GlobalAddress<T> target) {
       if (target.is_owner()) {
-        auto& owner_ts = GlobalAddress<T>::find_tardis_owner_info(target);
-
-        if (owner_ts.rts < Grappa::mypts()) {
-          owner_ts.rts = Grappa::mypts();
-        }
+        GlobalAddress<T>::for_each_tardis_owner_info(target, [](tardis_o_t& b) {
+          if (b.rts < Grappa::mypts()) {
+            b.rts = Grappa::mypts();
+          }
+        });
         return *target.pointer();
       }
+      if (impl::buffered_tardis_writes > 0) {
+        T r;
+        if (impl::read_buffered_tardis_write(target.raw_bits(), &r, sizeof(T))) {
+          return r;
+        }
+        impl::check_tardis_write_buffer();
+      }
 
       bool valid;
       auto& mycache = GlobalAddress<T>::find_tardis_cache(target, &valid);
       verify_cache(mycache);
       GlobalAddress<T>::active_cache(mycache);
-      if (try_read_cache(mycache, valid) == CacheState::Hit) {
+      if (try_read_cache(mycache, valid) == CacheState::Hit ||
+          impl::tardis_locale_fill(mycache)) {
+        __tardis_renew_soon(mycache);
         GlobalAddress<T>::deactive_cache(mycache);
         return *(T*)mycache.get_object();
       }
@@ -356,56 +687,191 @@ namespace Grappa {
       timestamp_t pts = Grappa::mypts();
       timestamp_t wts = mycache.wts;
 
-      // Expired: try to renew first
-#ifdef TARDIS_TWO_STAGE_RENEWAL
-      if (valid) {
-        auto r = call<S,C>(target.core(), [target, pts, wts]() {
-          auto& owner_ts = GlobalAddress<T>::find_tardis_owner_info(target);
-          owner_ts.lease = std::min<timestamp_t>(owner_ts.lease + 1, FLAGS_lease);
-          if (owner_ts.wts == wts) {
-            owner_ts.rts = std::max<timestamp_t>(std::max<timestamp_t>(
-                  owner_ts.rts, owner_ts.wts + owner_ts.lease), (pts + owner_ts.lease));
-            return owner_ts.rts;
-          }
-          else {
-            return (timestamp_t)~0L;
+      // Expired: depending on -tardis_renewal, first ask the owner to extend
+      // the lease of the copy we have, and refetch only if it has changed.
+      bool expired = valid;
+      if (expired) {
+        auto mode = tardis_renewal_mode();
+        if (mode == TARDIS_RENEWAL_TWO_STAGE ||
+            (mode == TARDIS_RENEWAL_ADAPTIVE && mycache.renew_first)) {
+          auto r = call<S,C>(target.core(), [target, pts, wts]() {
+            return __tardis_owner_renew(target, wts, pts, true);
+          });
+          if (r != (timestamp_t)~0L) {
+            tardis_renewal_renewed++;
+            mycache.rts = r;
+            impl::tardis_locale_publish(mycache);
+            GlobalAddress<T>::deactive_cache(mycache);
+            return *(T*)mycache.get_object();
           }
-        });
-        if (r != (timestamp_t)~0L) {
-          mycache.rts = r;
-          GlobalAddress<T>::deactive_cache(mycache);
-          return *(T*)mycache.get_object();
+          tardis_renewal_failed++;
+          // The owner has already seen this copy was overwritten.
+          expired = false;
         }
+        tardis_renewal_refetched++;
       }
-#endif
 
       // Ask for the latest object.
-      auto r = call<S,C>(target.core(), [target, pts]() {
-        auto& owner_ts = GlobalAddress<T>::find_tardis_owner_info(target);
-        owner_ts.lease = std::min<timestamp_t>(owner_ts.lease + 1, FLAGS_lease);
-        owner_ts.rts = std::max<timestamp_t>(std::max<timestamp_t>(
-              owner_ts.rts, owner_ts.wts + owner_ts.lease), (pts + owner_ts.lease));
-        return impl::rpc_read_result<T>(*target.pointer(), owner_ts);
+      if (FLAGS_tardis_owner_batch) {
+        FullEmpty<T> result;
+        delegate_ops++;
+        __tardis_fetch(target, &mycache, pts, expired, wts, &result);
+        return result.readFF();
+      }
+      Core me = Grappa::mycore();
+      auto r = call<S,C>(target.core(), [target, me, pts, expired, wts]() {
+        return __tardis_owner_read(target, me, pts, expired, wts);
       });
       mycache.assign(&r.r);
       mycache.rts = r.rts;
       mycache.wts = r.wts;
+      mycache.renew_first = r.renewable;
       Grappa::mypts() = std::max<timestamp_t>(pts, r.wts);
+      impl::tardis_locale_publish(mycache);
       // Other co-routines can access this cache now.
       GlobalAddress<T>::deactive_cache(mycache);
       return r.r;
     }
 
+    /// Park `d` at the back of the requests waiting for `info` to be unlocked.
+    static void __wi_enqueue(wi_o_t& info, SuspendedDelegate* d) {
+      delegate_wi_lock_waits++;
+      d->next = nullptr;
+      if (info.wait_tail != nullptr) {
+        info.wait_tail->next = d;
+      } else {
+        info.wait_head = d;
+      }
+      info.wait_tail = d;
+    }
+
+    /// Unlock `info` and serve the parked requests in arrival order, up to
+    /// and including the first one that takes the lock again.
+    static void __wi_unlock(wi_o_t& info) {
+      CHECK(info.locked);
+      info.locked = false;
+      while (!info.locked && info.wait_head != nullptr) {
+        Worker* w = info.wait_head;
+        info.wait_head = w->next;
+        if (info.wait_head == nullptr) info.wait_tail = nullptr;
+        w->next = nullptr;
+        invoke(reinterpret_cast<SuspendedDelegate*>(w));
+      }
+    }
+
+    // An object larger than its block is locked and shared in every block
+    // it overlaps (GlobalAddress::for_each_wi_owner_info); the helpers
+    // below act on all of them at once.
+
+    /// The first block of `target` that is locked, or null.
+    template< typename T >
+    static wi_o_t* __wi_locked_block(GlobalAddress<T> target) {
+      wi_o_t* locked = nullptr;
+      GlobalAddress<T>::for_each_wi_owner_info(target, [&locked](wi_o_t& b) {
+        if (locked == nullptr && b.locked) locked = &b;
+      });
+      return locked;
+    }
+
+    /// Cores that may hold a copy of any part of `target`.
+    template< typename T >
+    static impl::SharerSet __wi_sharers(GlobalAddress<T> target) {
+      impl::SharerSet sharers;
+      GlobalAddress<T>::for_each_wi_owner_info(target, [&sharers](wi_o_t& b) {
+        sharers.add_all(b.copyset);
+      });
+      return sharers;
+    }
+
+    /// Record that core `c` now holds a copy of `target`.
+    template< typename T >
+    static void __wi_share(GlobalAddress<T> target, Core c) {
+      GlobalAddress<T>::for_each_wi_owner_info(target, [c](wi_o_t& b) {
+        b.copyset.add(c);
+      });
+    }
+
+    template< typename T >
+    static void __wi_clear_sharers(GlobalAddress<T> target) {
+      GlobalAddress<T>::for_each_wi_owner_info(target, [](wi_o_t& b) {
+        b.copyset.clear();
+      });
+    }
+
+    /// Unlock every block of `target`, in order.
+    template< typename T >
+    static void __wi_unlock_blocks(GlobalAddress<T> target) {
+      GlobalAddress<T>::for_each_wi_owner_info(target, [](wi_o_t& b) {
+        __wi_unlock(b);
+      });
+    }
+
+    /// Run `run` on the owner of `target` as soon as none of its blocks is
+    /// locked, locking them all first if `lock`. A request that finds one
+    /// locked is parked on it and tries again once it is unlocked, so it
+    /// never holds some blocks while waiting for others.
+    template< typename T, typename F >
+    static void __wi_when_unlocked(GlobalAddress<T> target, bool lock, F run) {
+      if (wi_o_t* busy = __wi_locked_block(target)) {
+        __wi_enqueue(*busy, SuspendedDelegate::create([target, lock, run] {
+          __wi_when_unlocked(target, lock, run);
+        }));
+        return;
+      }
+      if (lock) {
+        GlobalAddress<T>::for_each_wi_owner_info(target, [](wi_o_t& b) {
+          b.locked = true;
+        });
+      }
+      run();
+    }
+
+    /// Suspend the calling task, on the owner of `target`, until the object
+    /// is unlocked; with `lock` it is then locked on the task's behalf.
+    template< typename T >
+    static void __wi_wait_unlocked(GlobalAddress<T> target, bool lock) {
+      if (__wi_locked_block(target) == nullptr) {
+        __wi_when_unlocked(target, lock, []{});
+        return;
+      }
+      Worker* me = impl::global_scheduler.get_current_thread();
+      __wi_when_unlocked(target, lock, [me] {
+        impl::global_scheduler.thread_wake(me);
+      });
+      impl::global_scheduler.thread_suspend();
+    }
+
+    /// Run `func()` on the owner of `target` as soon as the object is not
+    /// locked (locking it first if `lock`) and return the result. A
+    /// request that finds it locked is parked at the owner rather than
+    /// retried, like the Mutex version of delegate::call.
+    template< typename T, typename F >
+    static auto __wi_owner_call(GlobalAddress<T> target, bool lock, F func) ->
+        decltype(func()) {
+      using R = decltype(func());
+      delegate_ops++;
+      FullEmpty<R> result;
+      auto result_addr = make_global(&result);
+
+      send_message(target.core(), [target, lock, func, result_addr] {
+        delegate_targets++;
+        __wi_when_unlocked(target, lock, [func, result_addr] {
+          R val = func();
+          send_heap_message(result_addr.core(), [result_addr, val] {
+            result_addr->writeXF(val);
+          });
+        });
+      });
+      return result.readFE();
+    }
+
     template< SyncMode S = SyncMode::Blocking, 
               CacheMode M = CacheMode::WriteBack,
               GlobalCompletionEvent * C = &impl::local_gce,
               typename T = decltype(nullptr) >
     static T __wi_read(GlobalAddress<T> target) {
       if (target.is_owner()) {
-        auto& owner_ts = GlobalAddress<T>::find_wi_owner_info(target);
-        while (owner_ts.locked) {
-          Grappa::yield();
-        }
+        __wi_wait_unlocked(target, false);
         return *target.pointer();
       }
 
@@ -422,35 +888,30 @@ namespace Grappa {
       delegate_cache_miss++;
 
       Core my = Grappa::mycore();
-
-      // The object has been locked on the owner.
-retry:
-      auto r = call<S,C>(target.core(), [my, target]() {
-        auto& info = GlobalAddress<T>::find_wi_owner_info(target);
-        if (!info.locked) {
-          info.copyset[my] = true;
-        }
-        return lock_obj<T>{ *target.pointer(), info.locked };
+      auto r = __wi_owner_call(target, false, [my, target] {
+        __wi_share(target, my);
+        return *target.pointer();
       });
-      if (r.locked) {
-        goto retry;
-      }
 
       mycache.valid = true;
-      mycache.assign(&r.object);
+      mycache.assign(&r);
       GlobalAddress<T>::deactive_cache(mycache);
-      return r.object;
+      return r;
     }
 
     /// Read the value (potentially remote) at the given GlobalAddress, blocks the calling task until
     /// round-trip communication is complete.
-    /// @warning Target object must lie on a single node (not span blocks in global address space).
+    /// @warning Target object must lie on a single node (not span blocks in global address space);
+    /// use read_range() for larger objects.
     template< SyncMode S = SyncMode::Blocking, 
               CacheMode M = CacheMode::WriteBack,
               GlobalCompletionEvent * C = &impl::local_gce,
               typename T = decltype(nullptr) >
     T read(GlobalAddress<T> target) {
       delegate_reads++;
+      if (!FLAGS_delegate_trace.empty()) {
+        impl::trace_delegate(impl::TraceOp::Read, target.raw_bits(), target.core(), sizeof(T));
+      }
       double start_time = Grappa::timestamp();
       if (M == CacheMode::WriteThrough) {
         return __vanilla_read<S,M,C>(target);
@@ -492,20 +953,25 @@ retry:
       });
     }
 
+    template< typename T >
+    static void __publish_writes(const impl::buffered_write* w, size_t n,
+        const char* values);
+
+    void flush_writes();
+
     template< SyncMode S = SyncMode::Blocking, 
               CacheMode M = CacheMode::WriteBack,
               GlobalCompletionEvent * C = &impl::local_gce,
               typename T = decltype(nullptr),
               typename U = decltype(nullptr) >
     static void __tardis_write(GlobalAddress<T> target, U value) {
-      timestamp_t pts = Grappa::mypts();
       if (target.is_owner()) {
-        auto& owner_ts = GlobalAddress<T>::find_tardis_owner_info(target);
-        owner_ts.lease = 1;
-        timestamp_t ts = std::max<timestamp_t>(Grappa::mypts(), owner_ts.rts + 1);
-        Grappa::mypts() = owner_ts.rts = owner_ts.wts = ts;
-        /// Update owner storage.
-        *target.pointer() = value;
+        __tardis_owner_write<T>(target, value);
+        return;
+      }
+      if (M == CacheMode::WriteBack && FLAGS_tardis_write_buffer > 0) {
+        T v = value;
+        impl::buffer_tardis_write(&__publish_writes<T>, target.raw_bits(), &v, sizeof(T));
         return;
       }
 
@@ -514,19 +980,56 @@ retry:
       GlobalAddress<T>::active_cache(mycache);
       // No need to broadcast.
       auto r = call<S,C>(target.core(), [target, value] {
-        auto& owner_ts = GlobalAddress<T>::find_tardis_owner_info(target);
-        owner_ts.lease = 1;
-        timestamp_t ts = std::max<timestamp_t>(Grappa::mypts(), owner_ts.rts + 1);
-        Grappa::mypts() = owner_ts.wts = owner_ts.rts = ts;
-        *target.pointer() = value;
-        return ts;
+        return __tardis_owner_write<T>(target, value);
       });
       Grappa::mypts() = mycache.rts = mycache.wts =
         std::max<timestamp_t>(Grappa::mypts(), r);
-      mycache.assign(&value);
+      // value may be a narrower U; cache it as a T.
+      T v = value;
+      mycache.assign(&v);
       GlobalAddress<T>::deactive_cache(mycache);
     }
 
+    /// Invalidate the copies of `target` held by `sharers`, except on core
+    /// `skip`. Every invalidation is sent at once through the aggregator and
+    /// a single CompletionEvent collects the acks, so this costs one round
+    /// trip however many sharers there are.
+    template< typename T >
+    static void __wi_invalidate(GlobalAddress<T> target,
+        const impl::SharerSet& sharers, Core skip) {
+      CompletionEvent ce;
+      Core origin = Grappa::mycore();
+      sharers.for_each(Grappa::cores(), [&](Core c) {
+        if (c == skip) return;
+        delegate_inv++;
+        ce.enroll();
+        send_heap_message(c, [target, origin, &ce] {
+          if (!GlobalAddress<T>::invalidate_wi_block(target)) {
+            delegate_useless_inv++;
+          }
+          send_heap_message(origin, [&ce]{ ce.complete(); });
+        });
+      });
+      ce.wait();
+    }
+
+    /// Update `target` from a task on its owner: lock it, invalidate every
+    /// copy, apply `func` and unlock, returning what `func` returned.
+    template< typename T, typename F >
+    static auto __wi_owner_update(GlobalAddress<T> target, F func) ->
+        decltype(func(*target.pointer())) {
+      using R = decltype(func(*target.pointer()));
+      __wi_wait_unlocked(target, true);
+
+      __wi_invalidate(target, __wi_sharers(target), Grappa::mycore());
+      __wi_clear_sharers(target);
+
+      impl::update_result<R> res;
+      res.apply(func, *target.pointer());
+      __wi_unlock_blocks(target);
+      return res.get();
+    }
+
     template< SyncMode S = SyncMode::Blocking, 
               CacheMode M = CacheMode::WriteBack,
               GlobalCompletionEvent * C = &impl::local_gce,
@@ -534,31 +1037,7 @@ retry:
               typename U = decltype(nullptr) >
     static void __wi_write(GlobalAddress<T> target, U value) {
       if (target.is_owner()) {
-        auto& info = GlobalAddress<T>::find_wi_owner_info(target);
-
-        while (info.locked) {
-          Grappa::yield();
-        }
-        info.locked = true;
-
-        // Broadcast invalidation messages according to the copyset one-by-one.
-        forall_here<SyncMode::Blocking,nullptr> (0, info.copyset.size(), [&](int64_t i) {
-            delegate_inv++;
-            call<S,C>((Core)i, [target] {
-              bool valid;
-              auto& mycache = GlobalAddress<T>::find_wi_cache(target, &valid, false);
-              if (valid) {
-                mycache.valid = false;
-              }
-              else {
-                delegate_useless_inv++;
-              }
-            });
-        });
-        info.copyset.reset();
-
-        info.locked = false;
-        *target.pointer() = value;
+        __wi_owner_update(target, [&value](T& x) { x = value; });
         return;
       }
 
@@ -568,55 +1047,32 @@ retry:
 
       // Embedded delegataions are disallowed in Grappa.
       // Lock this object.
-retry:
-      auto r = call<S,C>(target.core(), [target] {
-        auto& info = GlobalAddress<T>::find_wi_owner_info(target);
-        if (!info.locked) {
-          info.locked = true;
-          return lock_obj<decltype(info.copyset)> { info.copyset, false };
-        }
-        else {
-          return lock_obj<decltype(info.copyset)> { info.copyset, true };
-        }
-      });
-      if (r.locked) {
-        goto retry;
-      }
-      auto& cpyset = r.object;
-
-      // Broadcast invalidation messages according to the copyset one-by-one.
-      forall_here<SyncMode::Blocking,nullptr> (0, cpyset.size(), [&](int64_t i) {
-          if (cpyset[i] && i != Grappa::mycore()) {
-            delegate_inv++;
-            call<S,C>((Core)i, [target] {
-              bool valid;
-              auto& mycache = GlobalAddress<T>::find_wi_cache(target, &valid, false);
-              if (valid) {
-                mycache.valid = false;
-              }
-              else {
-                delegate_useless_inv++;
-              }
-            });
-          }
+      auto cpyset = __wi_owner_call(target, true, [target] {
+        return __wi_sharers(target);
       });
+      __wi_invalidate(target, cpyset, Grappa::mycore());
 
       Core writer = Grappa::mycore();
       // Unlock this object and update the copyset.
       call<S,C>(target.core(), [target, value, writer] {
-        auto& info = GlobalAddress<T>::find_wi_owner_info(target);
-
-        info.copyset.reset();
-        info.copyset[writer] = true;
-        CHECK(info.locked);
-        info.locked = false;
+        __wi_clear_sharers(target);
+        __wi_share(target, writer);
         *target.pointer() = value;
+        __wi_unlock_blocks(target);
       });
+      // Only the written object stays valid here; other copies from its
+      // blocks (the blocks themselves, if read_range cached them) are now
+      // stale.
+      GlobalAddress<T>::invalidate_wi_block(target);
       mycache.valid = true;
-      mycache.assign(&value);
+      T v = value;
+      mycache.assign(&v);
       GlobalAddress<T>::deactive_cache(mycache);
     }
         
+    template< typename T >
+    static void __buffer_epoch_write(GlobalAddress<T> target, const T& value);
+
     /// Blocking remote write.
     /// @warning Target object must lie on a single node (not span blocks in global address space).
     template< SyncMode S = SyncMode::Blocking, 
@@ -626,7 +1082,14 @@ retry:
               typename U = decltype(nullptr) >
     void write(GlobalAddress<T> target, U value) {
       static_assert(std::is_convertible<T,U>(), "type of value must match GlobalAddress type");
+      if (M == CacheMode::WriteBack && impl::epoch_mode == EpochMode::ReadMostly) {
+        __buffer_epoch_write<T>(target, value);
+        return;
+      }
       delegate_writes++;
+      if (!FLAGS_delegate_trace.empty()) {
+        impl::trace_delegate(impl::TraceOp::Write, target.raw_bits(), target.core(), sizeof(T));
+      }
       double start_time = Grappa::timestamp();
       if (M == CacheMode::WriteThrough) {
         delegate_write_latency += (Grappa::timestamp() - start_time);
@@ -646,6 +1109,701 @@ retry:
       delegate_write_latency += (Grappa::timestamp() - start_time);
     }
     
+    /// Run `f(dest, idx, k)` for every batch of at most batch_size<T>()
+    /// entries of `idx` that share an owner core. `idx` must be ordered by
+    /// owner. Owners are served concurrently; batches for one owner are sent
+    /// one after another, in order.
+    template< typename T, typename F >
+    static void __for_each_owner_batch(const GlobalAddress<T>* targets,
+        const std::vector<size_t>& idx, F f) {
+      if (idx.empty()) return;
+      std::vector<size_t> runs;
+      for (size_t i = 0; i < idx.size(); i++) {
+        if (i == 0 || targets[idx[i]].core() != targets[idx[i-1]].core()) {
+          runs.push_back(i);
+        }
+      }
+      runs.push_back(idx.size());
+      forall_here<SyncMode::Blocking,nullptr,1>(0, runs.size() - 1, [&](int64_t r) {
+        Core dest = targets[idx[runs[r]]].core();
+        for (size_t b = runs[r]; b < runs[r+1]; b += batch_size<T>()) {
+          size_t k = std::min(batch_size<T>(), runs[r+1] - b);
+          delegate_batched_rpcs++;
+          f(dest, &idx[b], k);
+        }
+      });
+    }
+
+    /// Read `n` global addresses into `results`.
+    ///
+    /// Equivalent to calling read() on each address, but every address that
+    /// is not served by the local cache is fetched together with the other
+    /// misses on the same owner core: one round trip per owner (per
+    /// batch_size<T>() addresses) instead of one per address. Under Tardis
+    /// the owner extends all the leases at once; under WI it registers this
+    /// core in every copyset it can, and only addresses that were locked at
+    /// the time fall back to read(). Misses are held in the cache until they
+    /// arrive, so they are fetched half a cache (-max_cache_number) at a time.
+    template< SyncMode S = SyncMode::Blocking,
+              CacheMode M = CacheMode::WriteBack,
+              GlobalCompletionEvent * C = &impl::local_gce,
+              typename T = decltype(nullptr) >
+    void read_many(const GlobalAddress<T>* targets, size_t n, T* results) {
+      delegate_reads += n;
+      if (!FLAGS_delegate_trace.empty()) {
+        for (size_t i = 0; i < n; i++) {
+          impl::trace_delegate(impl::TraceOp::Read, targets[i].raw_bits(), targets[i].core(), sizeof(T));
+        }
+      }
+      double start_time = Grappa::timestamp();
+      const int proto = (M == CacheMode::WriteThrough) ? GRAPPA_VANILLA : FLAGS_cache_proto;
+      CHECK(proto == GRAPPA_VANILLA || proto == GRAPPA_TARDIS || proto == GRAPPA_WI)
+        << "No such protocol " << proto;
+
+      // Order by owner; repeated addresses become adjacent and are read once.
+      std::vector<size_t> order(n);
+      for (size_t i = 0; i < n; i++) order[i] = i;
+      std::sort(order.begin(), order.end(), [targets](size_t a, size_t b) {
+        return targets[a].core() != targets[b].core() ?
+          targets[a].core() < targets[b].core() :
+          targets[a].raw_bits() < targets[b].raw_bits();
+      });
+
+      // Pinned cache entries of the misses, parallel to `targets`.
+      std::vector<impl::cache_info_base*> entries(n, nullptr);
+      // Misses stay pinned until their batch returns; fetch them a slice of
+      // the cache at a time, so a long list never pins the whole cache.
+      const size_t pin_limit = (proto == GRAPPA_VANILLA) ? n :
+        std::max<size_t>(1, FLAGS_max_cache_number / 2);
+      for (size_t first = 0; first < n; ) {
+        std::vector<size_t> misses;
+        size_t o = first;
+        for (; o < n && misses.size() < pin_limit; o++) {
+          size_t i = order[o];
+          GlobalAddress<T> target = targets[i];
+          if (o > 0 && targets[order[o-1]].raw_bits() == target.raw_bits()) continue;
+
+          if (proto == GRAPPA_VANILLA) {
+            misses.push_back(i);
+          }
+          else if (proto == GRAPPA_TARDIS) {
+            if (target.is_owner()) {
+              results[i] = __tardis_read<S,M,C>(target);
+              continue;
+            }
+            if (impl::buffered_tardis_writes > 0 &&
+                impl::read_buffered_tardis_write(target.raw_bits(), &results[i], sizeof(T))) {
+              continue;
+            }
+            bool valid;
+            auto& mycache = GlobalAddress<T>::find_tardis_cache(target, &valid);
+            verify_cache(mycache);
+            GlobalAddress<T>::active_cache(mycache);
+            if (try_read_cache(mycache, valid) == CacheState::Hit ||
+                impl::tardis_locale_fill(mycache)) {
+              __tardis_renew_soon(mycache);
+              results[i] = *(T*)mycache.get_object();
+              GlobalAddress<T>::deactive_cache(mycache);
+              continue;
+            }
+            // Expired copies are refetched with the rest of the batch rather
+            // than renewed, which would cost a second round trip.
+            if (valid) tardis_renewal_refetched++;
+            entries[i] = &mycache;
+            misses.push_back(i);
+          }
+          else {
+            if (target.is_owner()) {
+              results[i] = __wi_read<S,M,C>(target);
+              continue;
+            }
+            bool valid;
+            auto& mycache = GlobalAddress<T>::find_wi_cache(target, &valid, true);
+            verify_cache(mycache);
+            GlobalAddress<T>::active_cache(mycache);
+            if (valid && mycache.valid) {
+              delegate_cache_hit++;
+              results[i] = *(T*)mycache.get_object();
+              GlobalAddress<T>::deactive_cache(mycache);
+              continue;
+            }
+            delegate_cache_miss++;
+            entries[i] = &mycache;
+            misses.push_back(i);
+          }
+        }
+
+        first = o;
+
+        struct request_t { GlobalAddress<T> a[batch_size<T>()]; };
+        __for_each_owner_batch(targets, misses, [&](Core dest, const size_t* idx, size_t k) {
+          request_t req;
+          for (size_t j = 0; j < k; j++) req.a[j] = targets[idx[j]];
+
+          if (proto == GRAPPA_VANILLA) {
+            struct reply_t { T r[batch_size<T>()]; };
+            auto rep = call<S,C>(dest, [req, k] {
+              reply_t rep;
+              for (size_t j = 0; j < k; j++) rep.r[j] = *req.a[j].pointer();
+              return rep;
+            });
+            for (size_t j = 0; j < k; j++) results[idx[j]] = rep.r[j];
+          }
+          else if (proto == GRAPPA_TARDIS) {
+            struct reply_t { impl::rpc_read_result<T> r[batch_size<T>()]; };
+            timestamp_t pts = Grappa::mypts();
+            Core me = Grappa::mycore();
+            auto rep = call<S,C>(dest, [req, k, me, pts] {
+              reply_t rep;
+              for (size_t j = 0; j < k; j++) rep.r[j] = __tardis_owner_read(req.a[j], me, pts);
+              return rep;
+            });
+            timestamp_t wts = pts;
+            for (size_t j = 0; j < k; j++) {
+              auto& mycache = *static_cast<tardis_c_t*>(entries[idx[j]]);
+              mycache.assign(&rep.r[j].r);
+              mycache.rts = rep.r[j].rts;
+              mycache.wts = rep.r[j].wts;
+              mycache.renew_first = rep.r[j].renewable;
+              wts = std::max<timestamp_t>(wts, rep.r[j].wts);
+              results[idx[j]] = rep.r[j].r;
+              impl::tardis_locale_publish(mycache);
+              GlobalAddress<T>::deactive_cache(mycache);
+            }
+            Grappa::mypts() = std::max<timestamp_t>(Grappa::mypts(), wts);
+          }
+          else {
+            struct reply_t { impl::lock_obj<T> r[batch_size<T>()]; };
+            Core my = Grappa::mycore();
+            auto rep = call<S,C>(dest, [req, k, my] {
+              reply_t rep;
+              for (size_t j = 0; j < k; j++) {
+                bool locked = __wi_locked_block(req.a[j]) != nullptr;
+                if (!locked) {
+                  __wi_share(req.a[j], my);
+                }
+                rep.r[j].object = *req.a[j].pointer();
+                rep.r[j].locked = locked;
+              }
+              return rep;
+            });
+            for (size_t j = 0; j < k; j++) {
+              auto& mycache = *static_cast<wi_c_t*>(entries[idx[j]]);
+              if (rep.r[j].locked) {
+                // A writer holds it; ask again on the ordinary path, which
+                // waits at the owner.
+                delegate_wi_lock_retries++;
+                GlobalAddress<T>::deactive_cache(mycache);
+                results[idx[j]] = __wi_read<S,M,C>(req.a[j]);
+                continue;
+              }
+              mycache.valid = true;
+              mycache.assign(&rep.r[j].object);
+              results[idx[j]] = rep.r[j].object;
+              GlobalAddress<T>::deactive_cache(mycache);
+            }
+          }
+        });
+
+      }
+
+      for (size_t o = 1; o < n; o++) {
+        if (targets[order[o]].raw_bits() == targets[order[o-1]].raw_bits()) {
+          results[order[o]] = results[order[o-1]];
+        }
+      }
+      delegate_read_latency += (Grappa::timestamp() - start_time);
+    }
+
+    /// Read the `n` objects starting at `start` into `out`, however many
+    /// blocks (and so cores) they span.
+    ///
+    /// The range is fetched as whole global blocks through read_many(), so
+    /// under Tardis and WI each block is cached and kept coherent on its own,
+    /// like any single-block object: a repeated read is served from the
+    /// cache, and a write to one object only refetches the block holding it.
+    /// Buffered Tardis writes to the range are published first, so the
+    /// blocks read include them.
+    template< SyncMode S = SyncMode::Blocking,
+              CacheMode M = CacheMode::WriteBack,
+              GlobalCompletionEvent * C = &impl::local_gce,
+              typename T = decltype(nullptr) >
+    void read_range(GlobalAddress<T> start, size_t n, T* out) {
+      if (n == 0) return;
+      size_t bytes = n * sizeof(T);
+      size_t off = GlobalAddress<T>::block_offset(start);
+      size_t nblocks = (off + bytes + block_size - 1) / block_size;
+      auto first = GlobalAddress<char>::Raw(start.raw_bits() - off);
+      if (impl::buffered_tardis_writes > 0 &&
+          impl::tardis_write_buffered_in(first.raw_bits(), nblocks * block_size)) {
+        flush_writes();
+      }
+
+      std::vector<GlobalAddress<impl::cache_block>> blocks(nblocks);
+      for (size_t b = 0; b < nblocks; b++) {
+        blocks[b] = static_cast<GlobalAddress<impl::cache_block>>(first + b * block_size);
+      }
+      std::vector<impl::cache_block> buf(nblocks);
+      read_many<S,M,C>(blocks.data(), nblocks, buf.data());
+      memcpy(out, reinterpret_cast<char*>(buf.data()) + off, bytes);
+    }
+
+    /// Result of read_async(): either the value, read at once from the
+    /// cache, or a fetch still in flight. Movable but not copyable; get()
+    /// blocks until the value is there, and so does dropping the handle
+    /// while the fetch is in flight.
+    template< typename T >
+    class ReadPromise {
+      T value_;
+      std::unique_ptr<FullEmpty<T>> pending_;
+
+    public:
+      ReadPromise(): value_(), pending_() {}
+      explicit ReadPromise(const T& value): value_(value), pending_() {}
+      explicit ReadPromise(FullEmpty<T>* pending): value_(), pending_(pending) {}
+      ReadPromise(ReadPromise&& other) = default;
+      ReadPromise& operator=(ReadPromise&& other) {
+        get();
+        value_ = other.value_;
+        pending_ = std::move(other.pending_);
+        return *this;
+      }
+      ~ReadPromise() { if (pending_) pending_->readFF(); }
+
+      /// True if get() will not block.
+      bool ready() const { return !pending_ || pending_->full(); }
+
+      const T& get() {
+        if (pending_) {
+          value_ = pending_->readFF();
+          pending_.reset();
+        }
+        return value_;
+      }
+    };
+
+    /// An async miss keeps its copy pinned until the reply arrives. Once
+    /// half the cache is pinned, read_async() reads synchronously instead,
+    /// so however many reads a task starts, misses can still evict.
+    template< typename E >
+    static bool __async_pins_exhausted(const impl::CacheTable<E>& cache) {
+      if (cache.pinned() < std::max<size_t>(1, FLAGS_max_cache_number / 2)) return false;
+      delegate_async_read_syncs++;
+      return true;
+    }
+
+    /// Tardis form of read_async. A miss or an expired copy is refetched in
+    /// one stage: -tardis_renewal's timestamp-only renewal would need a
+    /// second round trip.
+    template< typename T >
+    static ReadPromise<T> __tardis_read_async(GlobalAddress<T> target) {
+      if (target.is_owner()) return ReadPromise<T>(__tardis_read(target));
+      if (impl::buffered_tardis_writes > 0) {
+        T r;
+        if (impl::read_buffered_tardis_write(target.raw_bits(), &r, sizeof(T))) {
+          return ReadPromise<T>(r);
+        }
+        impl::check_tardis_write_buffer();
+      }
+      if (__async_pins_exhausted(GlobalCacheData::tardis_cache)) {
+        return ReadPromise<T>(__tardis_read(target));
+      }
+
+      bool valid;
+      auto& mycache = GlobalAddress<T>::find_tardis_cache(target, &valid);
+      verify_cache(mycache);
+      GlobalAddress<T>::active_cache(mycache);
+      if (try_read_cache(mycache, valid) == CacheState::Hit ||
+          impl::tardis_locale_fill(mycache)) {
+        __tardis_renew_soon(mycache);
+        GlobalAddress<T>::deactive_cache(mycache);
+        return ReadPromise<T>(*(T*)mycache.get_object());
+      }
+
+      // The copy stays pinned, and other tasks wait for it, until the reply
+      // has filled it in.
+      auto result = new FullEmpty<T>();
+      delegate_ops++;
+      delegate_async_ops++;
+      __tardis_fetch(target, &mycache, Grappa::mypts(), valid, mycache.wts, result);
+      return ReadPromise<T>(result);
+    }
+
+    /// WI form of read_async; a read that finds the object locked at the
+    /// owner is parked there, as in __wi_owner_call.
+    template< typename T >
+    static ReadPromise<T> __wi_read_async(GlobalAddress<T> target) {
+      if (target.is_owner()) return ReadPromise<T>(__wi_read(target));
+      if (__async_pins_exhausted(GlobalCacheData::wi_cache)) {
+        return ReadPromise<T>(__wi_read(target));
+      }
+
+      bool valid;
+      auto& mycache = GlobalAddress<T>::find_wi_cache(target, &valid, true);
+      verify_cache(mycache);
+      GlobalAddress<T>::active_cache(mycache);
+      if (valid && mycache.valid) {
+        delegate_cache_hit++;
+        GlobalAddress<T>::deactive_cache(mycache);
+        return ReadPromise<T>(*(T*)mycache.get_object());
+      }
+      delegate_cache_miss++;
+
+      wi_c_t* entry = &mycache;
+      auto result = new FullEmpty<T>();
+      Core origin = Grappa::mycore();
+      delegate_ops++;
+      delegate_async_ops++;
+      send_message(target.core(), [target, origin, entry, result] {
+        delegate_targets++;
+        __wi_when_unlocked(target, false, [target, origin, entry, result] {
+          __wi_share(target, origin);
+          T val = *target.pointer();
+          send_heap_message(origin, [entry, result, val] {
+            entry->valid = true;
+            entry->assign(&val);
+            GlobalAddress<T>::deactive_cache(*entry);
+            result->writeXF(val);
+          });
+        });
+      });
+      return ReadPromise<T>(result);
+    }
+
+    /// Start reading `target` and return at once.
+    ///
+    /// A read the cache (or the owner, or this core's write buffer) can
+    /// serve is done before read_async() returns; otherwise the request is
+    /// sent right away and the returned handle's get() waits for the reply,
+    /// which fills in the cache as read() would. One task can so keep many
+    /// misses in flight, to different owners, and pay about one round trip
+    /// for all of them (up to half the cache; later misses are read
+    /// synchronously until replies unpin their copies):
+    ///
+    /// @code
+    ///   std::vector<delegate::ReadPromise<T>> rs;
+    ///   for (auto a : addrs) rs.push_back(delegate::read_async(a));
+    ///   for (auto& r : rs) sum += r.get();
+    /// @endcode
+    template< CacheMode M = CacheMode::WriteBack,
+              typename T = decltype(nullptr) >
+    ReadPromise<T> read_async(GlobalAddress<T> target) {
+      delegate_reads++;
+      if (!FLAGS_delegate_trace.empty()) {
+        impl::trace_delegate(impl::TraceOp::Read, target.raw_bits(), target.core(), sizeof(T));
+      }
+      const int proto = (M == CacheMode::WriteThrough) ? GRAPPA_VANILLA : FLAGS_cache_proto;
+      if (proto == GRAPPA_TARDIS) return __tardis_read_async(target);
+      if (proto == GRAPPA_WI) return __wi_read_async(target);
+      CHECK(proto == GRAPPA_VANILLA) << "No such protocol " << proto;
+
+      if (target.is_owner()) return ReadPromise<T>(*target.pointer());
+      auto result = new FullEmpty<T>();
+      Core origin = Grappa::mycore();
+      delegate_ops++;
+      delegate_async_ops++;
+      send_message(target.core(), [target, origin, result] {
+        delegate_targets++;
+        T val = *target.pointer();
+        send_heap_message(origin, [result, val] { result->writeXF(val); });
+      });
+      return ReadPromise<T>(result);
+    }
+
+    /// write_many() without the Tardis write buffer, which must be empty or
+    /// hold none of `targets`; also how the buffer publishes itself.
+    template< SyncMode S = SyncMode::Blocking,
+              CacheMode M = CacheMode::WriteBack,
+              GlobalCompletionEvent * C = &impl::local_gce,
+              typename T = decltype(nullptr),
+              typename U = decltype(nullptr) >
+    static void __write_many(const GlobalAddress<T>* targets, const U* values, size_t n) {
+      static_assert(std::is_convertible<T,U>(), "type of value must match GlobalAddress type");
+      if (M == CacheMode::WriteBack && impl::epoch_mode == EpochMode::ReadMostly) {
+        for (size_t i = 0; i < n; i++) __buffer_epoch_write<T>(targets[i], values[i]);
+        return;
+      }
+      const int proto = (M == CacheMode::WriteThrough) ? GRAPPA_VANILLA : FLAGS_cache_proto;
+      if (proto == GRAPPA_WI) {
+        for (size_t i = 0; i < n; i++) write<S,M,C>(targets[i], values[i]);
+        return;
+      }
+      CHECK(proto == GRAPPA_VANILLA || proto == GRAPPA_TARDIS) << "No such protocol " << proto;
+      delegate_writes += n;
+      if (!FLAGS_delegate_trace.empty()) {
+        for (size_t i = 0; i < n; i++) {
+          impl::trace_delegate(impl::TraceOp::Write, targets[i].raw_bits(), targets[i].core(), sizeof(T));
+        }
+      }
+      double start_time = Grappa::timestamp();
+
+      // Group by owner, keeping program order within each owner.
+      std::vector<size_t> order;
+      for (size_t i = 0; i < n; i++) {
+        GlobalAddress<T> target = targets[i];
+        if (proto == GRAPPA_TARDIS && target.is_owner()) {
+          __tardis_write<S,M,C>(target, values[i]);
+        } else {
+          order.push_back(i);
+        }
+      }
+      std::stable_sort(order.begin(), order.end(), [targets](size_t a, size_t b) {
+        return targets[a].core() < targets[b].core();
+      });
+
+      struct request_t {
+        GlobalAddress<T> a[batch_size<T>()];
+        T v[batch_size<T>()];
+      };
+      __for_each_owner_batch(targets, order, [&](Core dest, const size_t* idx, size_t k) {
+        request_t req;
+        for (size_t j = 0; j < k; j++) {
+          req.a[j] = targets[idx[j]];
+          req.v[j] = values[idx[j]];
+        }
+        if (proto == GRAPPA_VANILLA) {
+          call<S,C>(dest, [req, k] {
+            for (size_t j = 0; j < k; j++) *req.a[j].pointer() = req.v[j];
+          });
+          return;
+        }
+        struct reply_t { timestamp_t ts[batch_size<T>()]; };
+        auto rep = call<S,C>(dest, [req, k] {
+          reply_t rep;
+          for (size_t j = 0; j < k; j++) rep.ts[j] = __tardis_owner_write(req.a[j], req.v[j]);
+          return rep;
+        });
+        for (size_t j = 0; j < k; j++) {
+          auto& mycache = GlobalAddress<T>::find_tardis_cache(req.a[j]);
+          verify_cache(mycache);
+          GlobalAddress<T>::active_cache(mycache);
+          Grappa::mypts() = mycache.rts = mycache.wts =
+            std::max<timestamp_t>(Grappa::mypts(), rep.ts[j]);
+          mycache.assign(&req.v[j]);
+          GlobalAddress<T>::deactive_cache(mycache);
+        }
+      });
+      delegate_write_latency += (Grappa::timestamp() - start_time);
+    }
+
+    /// Write `values[i]` to `targets[i]` for `i < n`, in order.
+    ///
+    /// Under Tardis (and without coherence) the writes for each owner core
+    /// travel in one RPC per batch_size<T>() addresses. WI writes must lock
+    /// and invalidate each object separately, so they go through write().
+    /// Writes are not buffered under -tardis_write_buffer: the buffer is
+    /// published first, so none of its older writes land after these.
+    template< SyncMode S = SyncMode::Blocking,
+              CacheMode M = CacheMode::WriteBack,
+              GlobalCompletionEvent * C = &impl::local_gce,
+              typename T = decltype(nullptr),
+              typename U = decltype(nullptr) >
+    void write_many(const GlobalAddress<T>* targets, const U* values, size_t n) {
+      if (impl::buffered_tardis_writes > 0) flush_writes();
+      __write_many<S,M,C>(targets, values, n);
+    }
+
+    /// Write out `n` buffered writes of type T in one __write_many().
+    template< typename T >
+    static void __publish_writes(const impl::buffered_write* w, size_t n,
+        const char* values) {
+      std::vector<GlobalAddress<T>> targets(n);
+      std::vector<T> v(n);
+      for (size_t i = 0; i < n; i++) {
+        targets[i] = GlobalAddress<T>::Raw(w[i].target);
+        memcpy(&v[i], values + w[i].offset, sizeof(T));
+      }
+      __write_many(targets.data(), v.data(), n);
+    }
+
+    /// Hold a write back until the current ReadMostly epoch ends.
+    template< typename T >
+    static void __buffer_epoch_write(GlobalAddress<T> target, const T& value) {
+      delegate_epoch_writes++;
+      size_t offset = impl::epoch_values.size();
+      impl::epoch_values.resize(offset + sizeof(T));
+      memcpy(&impl::epoch_values[offset], &value, sizeof(T));
+      impl::buffered_write w;
+      w.publish = &__publish_writes<T>;
+      w.target = target.raw_bits();
+      w.offset = offset;
+      w.size = sizeof(T);
+      impl::epoch_writes.push_back(w);
+    }
+
+    /// Publish every write this core holds in its Tardis write buffer
+    /// (-tardis_write_buffer), and wait until they are all done.
+    ///
+    /// The buffer is a per-core store buffer. A remote Tardis write goes
+    /// into it without a round trip; a later write to the same address just
+    /// replaces the value. Buffered writes are published in batches per
+    /// owner (one write_many per type) once the buffer fills up, or the
+    /// oldest has been held for a lease or -tardis_write_buffer_us, and the
+    /// returned timestamps move this core's clock as for any write. This
+    /// core reads its own buffered values at once, but other cores only see
+    /// them when published, so its reads may be ordered before its own
+    /// earlier writes. flush_writes(), atomics, begin_epoch(), end_epoch()
+    /// and the end of the program are fences.
+    void flush_writes();
+
+    /// Start an epoch in which cached delegates follow `mode`; call from a
+    /// single task, like on_all_cores(). Epochs do not nest.
+    ///
+    /// EpochMode::ReadMostly is for bulk-synchronous phases, e.g. an
+    /// iteration of a graph kernel, that read shared data and write results
+    /// nobody reads before the next phase. Inside it:
+    /// - cached copies stay valid however far clocks move: a hit costs no
+    ///   lease check, renewal or background renewal;
+    /// - delegate::write and write_many are buffered on the writing core,
+    ///   so reads (even the writer's own) see values from before the epoch
+    ///   unless they miss on an object nobody has published yet.
+    ///
+    /// Atomics and delegate::call(GlobalAddress, F) are not buffered.
+    void begin_epoch(EpochMode mode);
+
+    /// End the current epoch; call from a single task. Every core publishes
+    /// its buffered writes, batched per owner and type, and all clocks then
+    /// move past every version written, so each core sees every write once
+    /// end_epoch() returns.
+    void end_epoch();
+
+    /// Blocking form of __update.
+    template< GlobalCompletionEvent * C, typename T, typename F >
+    static auto __update(GlobalAddress<T> target, F func, std::false_type) ->
+        decltype(func(*target.pointer())) {
+      using R = decltype(func(*target.pointer()));
+      if (FLAGS_cache_proto == GRAPPA_TARDIS) {
+        if (impl::buffered_tardis_writes > 0) flush_writes();
+        impl::update_result<R> res;
+        if (target.is_owner()) {
+          __tardis_owner_update(target, [&res, &func](T& x) { res.apply(func, x); });
+          return res.get();
+        }
+        struct reply_t { impl::update_result<R> res; timestamp_t ts; };
+        auto rep = call<SyncMode::Blocking,C>(target.core(), [target, func] {
+          reply_t rep;
+          rep.ts = __tardis_owner_update(target, [&rep, &func](T& x) {
+            rep.res.apply(func, x);
+          });
+          return rep;
+        });
+        // Any copy we hold of the object is now behind us.
+        Grappa::mypts() = std::max<timestamp_t>(Grappa::mypts(), rep.ts);
+        return rep.res.get();
+      }
+      else if (FLAGS_cache_proto == GRAPPA_WI) {
+        if (target.is_owner()) return __wi_owner_update(target, func);
+
+        // An object nobody holds a copy of is updated on the spot, in one
+        // round trip. Otherwise it is locked (waiting at the owner if it
+        // already is), its sharers invalidated, and the update applied as
+        // it is unlocked, like a write.
+        struct first_t {
+          bool done;
+          impl::SharerSet sharers;
+          impl::update_result<R> res;
+        };
+        delegate_ops++;
+        FullEmpty<first_t> first;
+        auto first_addr = make_global(&first);
+        send_message(target.core(), [target, func, first_addr] {
+          delegate_targets++;
+          auto lock = [target, first_addr] {
+            first_t f;
+            f.done = false;
+            f.sharers = __wi_sharers(target);
+            send_heap_message(first_addr.core(), [first_addr, f] {
+              first_addr->writeXF(f);
+            });
+          };
+          if (__wi_locked_block(target) != nullptr || !__wi_sharers(target).empty()) {
+            __wi_when_unlocked(target, true, lock);
+          } else {
+            first_t f;
+            f.done = true;
+            f.res.apply(func, *target.pointer());
+            send_heap_message(first_addr.core(), [first_addr, f] {
+              first_addr->writeXF(f);
+            });
+          }
+        });
+        first_t f = first.readFE();
+        if (f.done) return f.res.get();
+
+        __wi_invalidate(target, f.sharers, Grappa::mycore());
+        GlobalAddress<T>::invalidate_wi_block(target);
+        auto res = call<SyncMode::Blocking,C>(target.core(), [target, func] {
+          __wi_clear_sharers(target);
+          impl::update_result<R> res;
+          res.apply(func, *target.pointer());
+          __wi_unlock_blocks(target);
+          return res;
+        });
+        return res.get();
+      }
+      return call<SyncMode::Blocking,C>(target.core(), [target, func] {
+        return func(*target.pointer());
+      });
+    }
+
+    /// Asynchronous form of __update; `func` returns void.
+    template< GlobalCompletionEvent * C, typename T, typename F >
+    static void __update(GlobalAddress<T> target, F func, std::true_type) {
+      if (FLAGS_cache_proto == GRAPPA_TARDIS) {
+        if (impl::buffered_tardis_writes > 0) flush_writes();
+        // We will not hear the new version's timestamp, so move our clock
+        // past the lease of any copy we hold instead.
+        auto& mycache = GlobalAddress<T>::find_tardis_cache(target, nullptr, false);
+        Grappa::mypts() = std::max<timestamp_t>(Grappa::mypts(), mycache.rts + 1);
+        call<SyncMode::Async,C>(target.core(), [target, func] {
+          __tardis_owner_update(target, func);
+        });
+      }
+      else if (FLAGS_cache_proto == GRAPPA_WI) {
+        // Invalidating the sharers waits for their acks, which takes a task
+        // at the owner; it reports to C when done, as spawnRemote does.
+        delegate_ops++;
+        delegate_async_ops++;
+        Core origin = Grappa::mycore();
+        if (C) C->enroll();
+        auto update = [target, func, origin] {
+          if (__wi_locked_block(target) == nullptr && __wi_sharers(target).empty()) {
+            func(*target.pointer());
+            if (C) C->send_completion(origin);
+            return;
+          }
+          spawn([target, func, origin] {
+            __wi_owner_update(target, func);
+            if (C) C->send_completion(origin);
+          });
+        };
+        if (target.core() == origin) {
+          update();
+        } else {
+          send_heap_message(target.core(), [update] {
+            delegate_targets++;
+            update();
+          });
+        }
+      }
+      else {
+        call<SyncMode::Async,C>(target.core(), [target, func] {
+          func(*target.pointer());
+        });
+      }
+    }
+
+    /// Apply `func` (taking a T&) to the object at `target` on its owner and
+    /// return its result, keeping cached copies coherent: under Tardis the
+    /// object gets a new version past every outstanding lease, and under WI
+    /// every other copy is invalidated first. Atomics and
+    /// delegate::call(GlobalAddress, F) are built on this.
+    template< SyncMode S, GlobalCompletionEvent * C, typename T, typename F >
+    static auto __update(GlobalAddress<T> target, F func) -> decltype(func(*target.pointer())) {
+      return __update<C>(target, func,
+          std::integral_constant<bool, S == SyncMode::Async>());
+    }
+
     /// Fetch the value at `target`, increment the value stored there with `inc` and return the
     /// original value to blocking thread.
     /// @warning Target object must lie on a single node (not span blocks in global address space).
@@ -655,11 +1813,10 @@ retry:
               typename U = decltype(nullptr) >
     T fetch_and_add(GlobalAddress<T> target, U inc) {
       delegate_fetchadds++;
-      return call(target.core(), [target, inc]() -> T {
+      return __update<S,C>(target, [inc](T& x) -> T {
         delegate_fetchadd_targets++;
-        T* p = target.pointer();
-        T r = *p;
-        *p += inc;
+        T r = x;
+        x += inc;
         return r;
       });
     }
@@ -752,10 +1909,10 @@ retry:
             uint64_t increment_total = increment;
             flat_combiner_fetch_and_add_amount += increment_total;
             auto t = target;
-            result = call(target.core(), [t, increment_total]() -> U {
-              T * p = t.pointer();
-              uint64_t r = *p;
-              *p += increment_total;
+            result = __update<SyncMode::Blocking,&impl::local_gce>(t,
+                [increment_total](T& x) -> U {
+              uint64_t r = x;
+              x += increment_total;
               return r;
             });
             // tell the others that the result has arrived
@@ -792,11 +1949,10 @@ retry:
       static_assert(std::is_convertible<T,V>(), "type of new_val must match GlobalAddress type");
       
       delegate_cmpswaps++;
-      return call(target.core(), [target, cmp_val, new_val]() -> bool {
-        T * p = target.pointer();
+      return __update<S,C>(target, [cmp_val, new_val](T& x) -> bool {
         delegate_cmpswap_targets++;
-        if (cmp_val == *p) {
-          *p = new_val;
+        if (cmp_val == x) {
+          x = new_val;
           return true;
         } else {
           return false;
@@ -811,9 +1967,7 @@ retry:
     void increment(GlobalAddress<T> target, U inc) {
       static_assert(std::is_convertible<T,U>(), "type of inc must match GlobalAddress type");
       delegate_async_increments++;
-      delegate::call<SyncMode::Async,C>(target.core(), [target,inc]{
-        (*target.pointer()) += inc;
-      });
+      __update<SyncMode::Async,C>(target, [inc](T& x) { x += inc; });
     }
     
   } // namespace delegate
@@ -55,6 +55,7 @@ namespace Grappa {
     inline void record_network_latency(int64_t start_time) {
       auto latency = Grappa::timestamp() - start_time;
       delegate_network_latency += latency;
+      global_rdma_aggregator.record_round_trip( latency );
     }
 
     inline void record_wakeup_latency(int64_t start_time, int64_t network_time) {
@@ -101,8 +102,8 @@ namespace Grappa {
             r->network_time = Grappa::timestamp();
             record_network_latency(r->start_time);
             ra->writeXF(r);
-          });
-        }); // send message
+          }, MessagePriority::Urgent);
+        }, MessagePriority::Urgent); // send message
 
         // ... and wait for the call to complete
         result.readFF();
@@ -158,8 +159,8 @@ namespace Grappa {
             d->network_time = Grappa::timestamp();
             record_network_latency(d->start_time);
             da->writeXF(d);
-          });
-        }); // send message
+          }, MessagePriority::Urgent);
+        }, MessagePriority::Urgent); // send message
         
         // ... and wait for the call to complete
         dfe.readFF();
@@ -0,0 +1,61 @@
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+namespace Grappa {
+namespace impl {
+
+/// Per-core binary log of delegate operations (-delegate_trace), replayed
+/// offline by CoherenceSim.exe.
+///
+/// Core c writes `<prefix>.<c>`: one trace_header, then one trace_record
+/// per address read or written through delegate::read, write, read_async,
+/// read_many or write_many, in the order they were issued.
+
+enum class TraceOp : uint8_t { Read = 0, Write = 1 };
+
+struct trace_header {
+  // "GDT" plus the format version.
+  char magic[4];
+  int16_t core;
+  int16_t cores;
+  // Ticks of Grappa::timestamp() per second, to relate record times.
+  uint64_t tick_rate;
+};
+
+struct trace_record {
+  // GlobalAddress::raw_bits() of the target.
+  uint64_t address;
+  // Grappa::timestamp() when the operation was issued.
+  uint64_t time;
+  uint32_t size;
+  // Core owning the target.
+  int16_t owner;
+  TraceOp op;
+  uint8_t pad;
+};
+
+static_assert(sizeof(trace_record) == 24, "trace records are written as is");
+
+static const char TRACE_MAGIC[4] = { 'G', 'D', 'T', '1' };
+
+/// Read the trace file at `path`. False if it cannot be opened or is not
+/// a trace; a truncated last record is dropped.
+inline bool read_trace(const char* path, trace_header* header,
+    std::vector<trace_record>* records) {
+  FILE* f = fopen(path, "rb");
+  if (f == nullptr) return false;
+  bool ok = fread(header, sizeof(*header), 1, f) == 1 &&
+    memcmp(header->magic, TRACE_MAGIC, sizeof(TRACE_MAGIC)) == 0;
+  if (ok) {
+    trace_record r;
+    while (fread(&r, sizeof(r), 1, f) == 1) records->push_back(r);
+  }
+  fclose(f);
+  return ok;
+}
+
+}
+}
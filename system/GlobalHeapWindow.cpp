@@ -0,0 +1,175 @@
+////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010-2015, University of Washington and Battelle
+// Memorial Institute.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//     * Redistributions of source code must retain the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer.
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials
+//       provided with the distribution.
+//     * Neither the name of the University of Washington, Battelle
+//       Memorial Institute, or the names of their contributors may be
+//       used to endorse or promote products derived from this
+//       software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// UNIVERSITY OF WASHINGTON OR BATTELLE MEMORIAL INSTITUTE BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+////////////////////////////////////////////////////////////////////////
+
+#include "GlobalHeapWindow.hpp"
+#include "Addressing.hpp"
+#include "Metrics.hpp"
+#include "Timestamp.hpp"
+
+#include <algorithm>
+#include <limits>
+
+DEFINE_int64( bulk_rma_threshold, 0, "Move Incoherent acquires and releases of at least this many bytes with one-sided MPI operations on the global heap (0 disables)" );
+
+GRAPPA_DEFINE_METRIC( SimpleMetric<uint64_t>, bulk_rma_gets, 0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<uint64_t>, bulk_rma_get_bytes, 0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<uint64_t>, bulk_rma_puts, 0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<uint64_t>, bulk_rma_put_bytes, 0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<uint64_t>, bulk_rma_operations, 0 );
+GRAPPA_DEFINE_METRIC( SummarizingMetric<uint64_t>, bulk_rma_ticks, 0 );
+
+namespace Grappa {
+namespace impl {
+
+GlobalHeapWindow global_heap_window;
+
+void GlobalHeapWindow::activate() {
+  if( FLAGS_bulk_rma_threshold <= 0 ) return;
+  MPI_CHECK( MPI_Win_create( global_memory_chunk_base, global_memory_chunk_size, 1,
+                             MPI_INFO_NULL, global_communicator.grappa_comm, &win_ ) );
+  // every core may target every other at any time, so open one
+  // passive-target epoch for the whole run
+  MPI_CHECK( MPI_Win_lock_all( MPI_MODE_NOCHECK, win_ ) );
+  active_ = true;
+}
+
+void GlobalHeapWindow::finish() {
+  if( !active_ ) return;
+  CHECK( pending_.empty() ) << "bulk transfers still in flight at shutdown";
+  active_ = false;
+  MPI_CHECK( MPI_Win_unlock_all( win_ ) );
+  MPI_CHECK( MPI_Win_free( &win_ ) );
+}
+
+void GlobalHeapWindow::get( BulkTransfer * t, intptr_t address, void * buf, size_t bytes ) {
+  t->put = false;
+  bulk_rma_gets++;
+  bulk_rma_get_bytes += bytes;
+  start( t, address, static_cast< char * >( buf ), bytes );
+}
+
+void GlobalHeapWindow::put( BulkTransfer * t, intptr_t address, const void * buf, size_t bytes ) {
+  t->put = true;
+  bulk_rma_puts++;
+  bulk_rma_put_bytes += bytes;
+  start( t, address, static_cast< char * >( const_cast< void * >( buf ) ), bytes );
+}
+
+void GlobalHeapWindow::start( BulkTransfer * t, intptr_t address, char * buf, size_t bytes ) {
+  CHECK( active_ ) << "global heap window not active";
+  t->done.reset();
+  t->outstanding = 0;
+  t->bytes = bytes;
+  t->start = Grappa::timestamp();
+
+  // Split the range by home core. Each core's blocks follow each other
+  // in its chunk; on our side they are `cores` blocks apart.
+  struct Piece {
+    std::vector< int > lengths;
+    std::vector< MPI_Aint > offsets;
+    MPI_Aint target;
+    size_t bytes;
+    Piece(): lengths(), offsets(), target(0), bytes(0) {}
+  };
+  const Core ncores = Grappa::cores();
+  std::vector< Piece > pieces( ncores );
+  for( size_t offset = 0; offset < bytes; ) {
+    intptr_t a = address + offset;
+    intptr_t block = a / block_size;
+    Core core = block % ncores;
+    size_t length = std::min< size_t >( block_size - a % block_size, bytes - offset );
+    Piece & p = pieces[core];
+    if( p.bytes == 0 ) {
+      p.target = ( block / ncores ) * block_size + a % block_size;
+    }
+    if( !p.offsets.empty() && p.offsets.back() + p.lengths.back() == (MPI_Aint) offset ) {
+      p.lengths.back() += length;
+    } else {
+      p.lengths.push_back( length );
+      p.offsets.push_back( offset );
+    }
+    p.bytes += length;
+    offset += length;
+  }
+
+  for( Core core = 0; core < ncores; ++core ) {
+    Piece & p = pieces[core];
+    if( p.bytes == 0 ) continue;
+    CHECK_LE( p.bytes, (size_t) std::numeric_limits< int >::max() ) << "bulk transfer too large";
+
+    Pending q;
+    q.target = core;
+    q.transfer = t;
+    MPI_CHECK( MPI_Type_create_hindexed( p.lengths.size(), &p.lengths[0], &p.offsets[0],
+                                         MPI_BYTE, &q.type ) );
+    MPI_CHECK( MPI_Type_commit( &q.type ) );
+    if( t->put ) {
+      MPI_CHECK( MPI_Rput( buf, 1, q.type, core, p.target, p.bytes, MPI_BYTE, win_, &q.request ) );
+    } else {
+      MPI_CHECK( MPI_Rget( buf, 1, q.type, core, p.target, p.bytes, MPI_BYTE, win_, &q.request ) );
+    }
+    bulk_rma_operations++;
+    t->outstanding++;
+    pending_.push_back( q );
+  }
+}
+
+void GlobalHeapWindow::poll() {
+  for( size_t i = 0; i < pending_.size(); ) {
+    int flag;
+    MPI_CHECK( MPI_Test( &pending_[i].request, &flag, MPI_STATUS_IGNORE ) );
+    if( !flag ) {
+      ++i;
+      continue;
+    }
+    Pending q = pending_[i];
+    pending_[i] = pending_.back();
+    pending_.pop_back();
+
+    // a completed put request only means our buffer is free again
+    if( q.transfer->put ) {
+      MPI_CHECK( MPI_Win_flush( q.target, win_ ) );
+    }
+    MPI_CHECK( MPI_Type_free( &q.type ) );
+
+    BulkTransfer * t = q.transfer;
+    if( --t->outstanding == 0 ) {
+      bulk_rma_ticks += Grappa::timestamp() - t->start;
+      t->done.writeXF( t->bytes );
+    }
+  }
+}
+
+} // namespace impl
+} // namespace Grappa
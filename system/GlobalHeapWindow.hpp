@@ -0,0 +1,114 @@
+////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010-2015, University of Washington and Battelle
+// Memorial Institute.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//     * Redistributions of source code must retain the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer.
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials
+//       provided with the distribution.
+//     * Neither the name of the University of Washington, Battelle
+//       Memorial Institute, or the names of their contributors may be
+//       used to endorse or promote products derived from this
+//       software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// UNIVERSITY OF WASHINGTON OR BATTELLE MEMORIAL INSTITUTE BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <vector>
+#include <gflags/gflags.h>
+
+#include "Communicator.hpp"
+#include "FullEmptyLocal.hpp"
+
+DECLARE_int64( bulk_rma_threshold );
+
+namespace Grappa {
+namespace impl {
+
+/// A get or put issued on the global heap window. Owned by the caller,
+/// which waits on `done`; it is filled with the bytes moved once every
+/// core's piece has completed.
+struct BulkTransfer {
+  FullEmpty< size_t > done;
+  int outstanding;
+  size_t bytes;
+  bool put;
+  int64_t start;
+
+  BulkTransfer(): done(), outstanding(0), bytes(0), put(false), start(0) {}
+};
+
+/// Exposes each core's chunk of the global heap as an MPI window
+/// (-bulk_rma_threshold), so that large transfers to and from linear
+/// global addresses can be done with one-sided MPI_Rget/MPI_Rput instead
+/// of being cut into block-sized messages and copied through the
+/// aggregator.
+///
+/// A core's blocks within a linear range are contiguous in its chunk, so
+/// a transfer issues one operation per core touched, with an indexed
+/// datatype scattering the blocks on the local side. Requests are tested
+/// from Communicator::poll(); a put is flushed to its target before it
+/// counts as done.
+class GlobalHeapWindow {
+private:
+  struct Pending {
+    MPI_Request request;
+    MPI_Datatype type;
+    Core target;
+    BulkTransfer * transfer;
+  };
+
+  MPI_Win win_;
+  bool active_;
+  std::vector< Pending > pending_;
+
+  void start( BulkTransfer * t, intptr_t address, char * buf, size_t bytes );
+
+public:
+  GlobalHeapWindow(): win_(MPI_WIN_NULL), active_(false), pending_() {}
+
+  /// Collective: create the window once the global heap is allocated.
+  void activate();
+
+  /// Collective: free the window before the global heap goes away.
+  void finish();
+
+  /// Should a transfer of `bytes` at global address bits `address` use the window?
+  bool use_for( intptr_t address, bool is_2D, size_t bytes ) const {
+    return active_ && !is_2D && bytes >= (size_t) FLAGS_bulk_rma_threshold;
+  }
+
+  /// Read `bytes` starting at linear address `address` into `buf`.
+  void get( BulkTransfer * t, intptr_t address, void * buf, size_t bytes );
+
+  /// Write `bytes` from `buf` starting at linear address `address`.
+  void put( BulkTransfer * t, intptr_t address, const void * buf, size_t bytes );
+
+  /// Complete finished requests. Called from Communicator::poll().
+  void poll();
+};
+
+/// global GlobalHeapWindow instance
+extern GlobalHeapWindow global_heap_window;
+
+} // namespace impl
+} // namespace Grappa
@@ -0,0 +1,129 @@
+////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010-2015, University of Washington and Battelle
+// Memorial Institute.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//     * Redistributions of source code must retain the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer.
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials
+//       provided with the distribution.
+//     * Neither the name of the University of Washington, Battelle
+//       Memorial Institute, or the names of their contributors may be
+//       used to endorse or promote products derived from this
+//       software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// UNIVERSITY OF WASHINGTON OR BATTELLE MEMORIAL INSTITUTE BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+////////////////////////////////////////////////////////////////////////
+
+/// Tests for bulk Incoherent transfers through the global heap window
+
+#include <boost/test/unit_test.hpp>
+#include <Grappa.hpp>
+#include <Cache.hpp>
+#include <GlobalHeapWindow.hpp>
+
+DEFINE_int64( bulk_test_elements, 1 << 18, "Size of the array moved by the bandwidth comparison" );
+DEFINE_int64( bulk_test_repeats, 8, "Times each path moves the array" );
+
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, message_acquire_bandwidth, 0.0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, message_release_bandwidth, 0.0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, rma_acquire_bandwidth, 0.0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, rma_release_bandwidth, 0.0 );
+
+BOOST_AUTO_TEST_SUITE( GlobalHeapWindow_tests );
+
+using namespace Grappa;
+
+static void set_threshold( int64_t threshold ) {
+  on_all_cores( [threshold] { FLAGS_bulk_rma_threshold = threshold; } );
+}
+
+BOOST_AUTO_TEST_CASE( test1 ) {
+  // the window is only created when the path is enabled at startup
+  FLAGS_bulk_rma_threshold = 4096;
+  init( GRAPPA_TEST_ARGS );
+  run([]{
+    const int64_t n = FLAGS_bulk_test_elements;
+    auto array = global_alloc< int64_t >( n );
+    // release messages read their payload from here after sending
+    int64_t * buf = locale_alloc< int64_t >( n );
+
+    BOOST_MESSAGE( "Checking RMA transfers against messages" );
+    // odd start and length, so first and last blocks are partial
+    auto sub = array + 3;
+    const int64_t m = n - 7;
+    for( int64_t i = 0; i < m; ++i ) buf[i] = i * 7 + 1;
+    { Incoherent< int64_t >::WO w( sub, m, buf ); }
+    BOOST_CHECK_EQUAL( delegate::read( sub ), 1 );
+    BOOST_CHECK_EQUAL( delegate::read( sub + m - 1 ), (m - 1) * 7 + 1 );
+
+    set_threshold( std::numeric_limits< int64_t >::max() );
+    std::fill( buf, buf + n, 0 );
+    { Incoherent< int64_t >::RO r( sub, m, buf ); r.block_until_acquired(); }
+    for( int64_t i = 0; i < m; ++i ) {
+      if( buf[i] != i * 7 + 1 ) { BOOST_CHECK_EQUAL( buf[i], i * 7 + 1 ); break; }
+    }
+
+    for( int64_t i = 0; i < m; ++i ) buf[i] = i * 5 + 2;
+    { Incoherent< int64_t >::WO w( sub, m, buf ); }
+    set_threshold( 4096 );
+    std::fill( buf, buf + n, 0 );
+    { Incoherent< int64_t >::RO r( sub, m, buf ); r.block_until_acquired(); }
+    for( int64_t i = 0; i < m; ++i ) {
+      if( buf[i] != i * 5 + 2 ) { BOOST_CHECK_EQUAL( buf[i], i * 5 + 2 ); break; }
+    }
+
+    BOOST_MESSAGE( "Comparing bandwidth" );
+    const double bytes = n * sizeof(int64_t) * FLAGS_bulk_test_repeats;
+    for( bool rma : { false, true } ) {
+      set_threshold( rma ? 4096 : std::numeric_limits< int64_t >::max() );
+
+      double start = walltime();
+      for( int64_t r = 0; r < FLAGS_bulk_test_repeats; ++r ) {
+        Incoherent< int64_t >::WO w( array, n, buf );
+      }
+      double release = bytes / (walltime() - start);
+
+      start = walltime();
+      for( int64_t r = 0; r < FLAGS_bulk_test_repeats; ++r ) {
+        Incoherent< int64_t >::RO c( array, n, buf );
+        c.block_until_acquired();
+      }
+      double acquire = bytes / (walltime() - start);
+
+      LOG(INFO) << (rma ? "RMA" : "message") << " path: acquire " << acquire / 1e6
+                << " MB/s, release " << release / 1e6 << " MB/s";
+      if( rma ) {
+        rma_acquire_bandwidth = acquire;
+        rma_release_bandwidth = release;
+      } else {
+        message_acquire_bandwidth = acquire;
+        message_release_bandwidth = release;
+      }
+    }
+
+    locale_free( buf );
+    global_free( array );
+    Metrics::merge_and_print();
+  });
+  finalize();
+}
+
+BOOST_AUTO_TEST_SUITE_END();
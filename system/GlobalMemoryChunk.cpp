@@ -63,6 +63,7 @@ DEFINE_int64( global_memory_per_node_base_address, 0x0000123400000000L, "UNUSED:
 namespace Grappa {
 namespace impl {
 void * global_memory_chunk_base = NULL;
+size_t global_memory_chunk_size = 0;
 }
 }
 
@@ -80,5 +81,6 @@ GlobalMemoryChunk::GlobalMemoryChunk( size_t size )
   memory_ = Grappa::impl::locale_shared_memory.allocate_aligned( size_, 64 );
   CHECK_NOTNULL( memory_ );
   Grappa::impl::global_memory_chunk_base = memory_;
+  Grappa::impl::global_memory_chunk_size = size_;
   DVLOG(2) << "Core " << Grappa::mycore() << " allocated " << size_ << " bytes ";
 }
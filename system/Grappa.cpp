@@ -39,6 +39,7 @@
 #endif
 
 #include "GlobalMemory.hpp"
+#include "GlobalHeapWindow.hpp"
 #include "tasks/Task.hpp"
 #include "Cache.hpp"
 #include "PerformanceTools.hpp"
@@ -189,6 +190,9 @@ static void poller( Worker * me, void * args ) {
     global_scheduler.stats.sample();
 
     Grappa::impl::poll();
+
+    // publish Tardis writes buffered on a core that has gone quiet
+    Grappa::impl::poll_tardis_write_buffer();
     
     // check async. io completions
     if (aio_completed_stack) {
@@ -617,6 +621,7 @@ void Grappa_activate()
   // initializes system_wide global_memory pointer
   global_communicator.allreduce_inplace( &Grappa::impl::global_memory_size_bytes, MPI_INT64_T, MPI_MIN );
   global_memory = new GlobalMemory( Grappa::impl::global_memory_size_bytes );
+  Grappa::impl::global_heap_window.activate();
   auto heap_locale_shared_memory_allocated = locale_shared_memory.get_allocated();
 
   // fire up polling thread
@@ -628,6 +633,8 @@ void Grappa_activate()
   
   SharedMessagePool::activate();
   auto shared_pool_locale_shared_memory_allocated = locale_shared_memory.get_allocated();
+
+  Grappa::impl::start_delegate_trace();
   
   if (Grappa::mycore() == 0) {
     double node_sz_gb = static_cast<double>(FLAGS_node_memsize) / (1L<<30);
@@ -692,6 +699,8 @@ bool Grappa_global_queue_isInit() {
 void Grappa_end_tasks() {
   // send task termination signal
   CHECK( Grappa::mycore() == 0 );
+  // publish writes still held in Tardis write buffers
+  Grappa::on_all_cores( [] { Grappa::delegate::flush_writes(); } );
   // TODO: we should really flush the aggregator here.
   for ( Core n = 0; n < Grappa::cores(); n++ ) {
     global_communicator.send_immediate( n, [] {
@@ -726,6 +735,9 @@ int Grappa_finish( int retval )
   global_task_manager.finish();
   global_aggregator.finish();
 
+  Grappa::impl::finish_delegate_trace();
+
+  Grappa::impl::global_heap_window.finish();
   if (global_memory) delete global_memory;
 
 //  Grappa_dump_stats();
@@ -45,6 +45,10 @@ GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, acquire_blocked, 0);
 GRAPPA_DEFINE_METRIC(SummarizingMetric<uint64_t>, acquire_blocked_ticks_total, 0);
 GRAPPA_DEFINE_METRIC(SummarizingMetric<uint64_t>, acquire_network_ticks_total, 0);
 GRAPPA_DEFINE_METRIC(SummarizingMetric<uint64_t>, acquire_wakeup_ticks_total, 0);
+GRAPPA_DEFINE_METRIC(SummarizingMetric<double>, acquire_message_bandwidth, 0.0);
+GRAPPA_DEFINE_METRIC(SummarizingMetric<double>, acquire_rma_bandwidth, 0.0);
+
+namespace Grappa { extern double tick_rate; }
 
     
 void IAMetrics::count_acquire_ams( uint64_t bytes ) {
@@ -67,3 +71,15 @@ void IAMetrics::record_network_latency( int64_t start_time ) {
   acquire_network_ticks_total += latency;
 }
 
+/// Bytes per second from issuing an acquire to having all of it, by
+/// messages or through the global heap window (-bulk_rma_threshold).
+void IAMetrics::record_bandwidth( uint64_t bytes, int64_t issue_time, bool bulk ) {
+  int64_t ticks = Grappa::timestamp() - issue_time;
+  if( ticks <= 0 ) return;
+  double bandwidth = bytes / ( ticks / Grappa::tick_rate );
+  if( bulk ) {
+    acquire_rma_bandwidth += bandwidth;
+  } else {
+    acquire_message_bandwidth += bandwidth;
+  }
+}
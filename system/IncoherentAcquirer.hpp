@@ -37,6 +37,7 @@
 
 #include "Addressing.hpp"
 #include "Message.hpp"
+#include "GlobalHeapWindow.hpp"
 #include "tasks/TaskingScheduler.hpp"
 
 // forward declare for active message templates
@@ -49,6 +50,7 @@ public:
   static void count_acquire_ams( uint64_t bytes ) ;
   static void record_wakeup_latency( int64_t start_time, int64_t network_time ) ; 
   static void record_network_latency( int64_t start_time ) ; 
+  static void record_bandwidth( uint64_t bytes, int64_t issue_time, bool bulk ) ;
 };
 
 /// IncoherentAcquirer behavior for Cache.
@@ -67,6 +69,9 @@ private:
   int expected_reply_payload_;
   int64_t start_time_;
   int64_t network_time_;
+  int64_t issue_time_;
+  bool bulk_;
+  Grappa::impl::BulkTransfer bulk_transfer_;
 
 public:
 
@@ -83,13 +88,16 @@ public:
     , expected_reply_payload_( 0 )
     , start_time_(0)
     , network_time_(0)
+    , issue_time_(0)
+    , bulk_(false)
+    , bulk_transfer_()
   { 
     reset( );
   }
 
   void reset( ) {
     DVLOG(5) << "In " << __PRETTY_FUNCTION__;
-    CHECK( !acquire_started_ || acquired_ ) << "inconsistent state for reset";
+    CHECK( !acquire_started_ || acquired() ) << "inconsistent state for reset";
     acquire_started_ = false;
     acquired_ = false;
     thread_ = NULL;
@@ -99,6 +107,8 @@ public:
     total_reply_payload_ = 0;
     start_time_ = 0;
     network_time_ = 0;
+    issue_time_ = 0;
+    bulk_ = false;
     if( *count_ == 0 ) {
       DVLOG(5) << "Zero-length acquire";
       *pointer_ = NULL;
@@ -156,7 +166,15 @@ public:
       size_t nmsg = total_bytes / block_size + 2;
       size_t msg_size = sizeof(Grappa::Message<RequestArgs>);
       
-      do_acquire();
+      issue_time_ = Grappa::timestamp();
+      if( Grappa::impl::global_heap_window.use_for( request_address_->raw_bits(),
+                                                    request_address_->is_2D(), total_bytes ) ) {
+        bulk_ = true;
+        Grappa::impl::global_heap_window.get( &bulk_transfer_, request_address_->raw_bits(),
+                                              *pointer_, total_bytes );
+      } else {
+        do_acquire();
+      }
     }
   }
 
@@ -242,6 +260,13 @@ public:
       } else {
         start_time_ = 0;
       }
+      if( bulk_ ) {
+        bulk_transfer_.done.readFF();
+        acquired_ = true;
+        network_time_ = Grappa::timestamp();
+        IAMetrics::record_network_latency( start_time_ );
+        IAMetrics::record_bandwidth( bulk_transfer_.bytes, issue_time_, true );
+      }
       while( !acquired_ ) {
       DVLOG(5) << "Worker " << Grappa::current_worker() 
               << " blocking on " << *request_address_ 
@@ -272,6 +297,7 @@ public:
                                                                  << " and sizeof(T) = " << sizeof(T) 
                                                                  << " and count = " << *count_;
       acquired_ = true;
+      IAMetrics::record_bandwidth( total_reply_payload_, issue_time_, false );
       if( thread_ != NULL ) {
         Grappa::wake( thread_ );
       }
@@ -283,7 +309,7 @@ public:
   }
 
   /// Has acquire completed?
-  bool acquired() const { return acquired_; }
+  bool acquired() const { return acquired_ || ( bulk_ && bulk_transfer_.done.full() ); }
 
   /// Args for incoherent acquire request 
   struct RequestArgs {
@@ -37,8 +37,25 @@
 
 GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>,  release_ams, 0);
 GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>,  release_ams_bytes, 0);
+GRAPPA_DEFINE_METRIC(SummarizingMetric<double>, release_message_bandwidth, 0.0);
+GRAPPA_DEFINE_METRIC(SummarizingMetric<double>, release_rma_bandwidth, 0.0);
+
+namespace Grappa { extern double tick_rate; }
 
 void IRMetrics::count_release_ams( uint64_t bytes ) {
   release_ams++;
   release_ams_bytes+=bytes;
 }
+
+/// Bytes per second from issuing a release to its last write landing, by
+/// messages or through the global heap window (-bulk_rma_threshold).
+void IRMetrics::record_bandwidth( uint64_t bytes, int64_t issue_time, bool bulk ) {
+  int64_t ticks = Grappa::timestamp() - issue_time;
+  if( ticks <= 0 ) return;
+  double bandwidth = bytes / ( ticks / Grappa::tick_rate );
+  if( bulk ) {
+    release_rma_bandwidth += bandwidth;
+  } else {
+    release_message_bandwidth += bandwidth;
+  }
+}
@@ -36,6 +36,7 @@
 #define __INCOHERENT_RELEASER_HPP__
 
 #include "Message.hpp"
+#include "GlobalHeapWindow.hpp"
 #include "tasks/TaskingScheduler.hpp"
 
 // forward declare for active message templates
@@ -46,6 +47,7 @@ class IncoherentReleaser;
 class IRMetrics {
   public:
     static void count_release_ams( uint64_t bytes );
+    static void record_bandwidth( uint64_t bytes, int64_t issue_time, bool bulk );
 };
 
 /// IncoherentReleaser behavior for cache.
@@ -60,7 +62,9 @@ private:
   Grappa::Worker * thread_;
   int num_messages_;
   int response_count_;
-
+  int64_t issue_time_;
+  bool bulk_;
+  Grappa::impl::BulkTransfer bulk_transfer_;
 
 public:
 
@@ -73,17 +77,22 @@ public:
     , thread_(NULL)
     , num_messages_(0)
     , response_count_(0)
+    , issue_time_(0)
+    , bulk_(false)
+    , bulk_transfer_()
   { 
     reset();
   }
     
   void reset( ) {
-    CHECK( !release_started_ || released_ ) << "inconsistent state for reset";
+    CHECK( !release_started_ || released() ) << "inconsistent state for reset";
     release_started_ = false;
     released_ = false;
     thread_ = NULL;
     num_messages_ = 0;
     response_count_ = 0;
+    issue_time_ = 0;
+    bulk_ = false;
     if( *count_ == 0 ) {
       DVLOG(5) << "Zero-length release";
       release_started_ = true;
@@ -141,7 +150,15 @@ public:
       size_t nmsg = total_bytes / block_size + 2;
       size_t msg_size = sizeof(Grappa::PayloadMessage<RequestArgs>);
       
-      do_release();
+      issue_time_ = Grappa::timestamp();
+      if( Grappa::impl::global_heap_window.use_for( request_address_->raw_bits(),
+                                                    request_address_->is_2D(), total_bytes ) ) {
+        bulk_ = true;
+        Grappa::impl::global_heap_window.put( &bulk_transfer_, request_address_->raw_bits(),
+                                              *pointer_, total_bytes );
+      } else {
+        do_release();
+      }
     }
   }
   
@@ -206,6 +223,11 @@ public:
       DVLOG(5) << "Worker " << Grappa::current_worker() 
               << " ready to block on " << *request_address_ 
               << " * " << *count_ ;
+      if( bulk_ ) {
+        bulk_transfer_.done.readFF();
+        released_ = true;
+        IRMetrics::record_bandwidth( bulk_transfer_.bytes, issue_time_, true );
+      }
       while( !released_ ) {
         DVLOG(5) << "Worker " << Grappa::current_worker() 
                 << " blocking on " << *request_address_ 
@@ -228,6 +250,7 @@ public:
     ++response_count_;
     if ( response_count_ == num_messages_ ) {
       released_ = true;
+      IRMetrics::record_bandwidth( *count_ * sizeof(T), issue_time_, false );
       if( thread_ != NULL ) {
         DVLOG(5) << "Worker " << Grappa::current_worker() 
                  << " waking Worker " << thread_;
@@ -236,7 +259,7 @@ public:
     }
   }
 
-  bool released() const { return released_; }
+  bool released() const { return released_ || ( bulk_ && bulk_transfer_.done.full() ); }
   
   struct RequestArgs {
     GlobalAddress< T > request_address;
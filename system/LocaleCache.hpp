@@ -0,0 +1,150 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <atomic>
+#include <glog/logging.h>
+
+namespace Grappa {
+namespace impl {
+
+/// Tardis copies shared by all the cores of a locale (-tardis_locale_cache),
+/// as a second tier behind each core's private cache.
+///
+/// A copy is one version of an object together with its lease [wts, rts].
+/// Any core whose clock is within the lease may read it, whichever core
+/// fetched it, so one fetch or renewal on a locale serves all its cores.
+///
+/// The slots live in locale shared memory and are direct mapped: a copy
+/// goes to the slot its key hashes to, replacing whatever was there unless
+/// that is a newer copy of the same object. Each slot has a sequence number
+/// that is odd while a core is writing it. A reader copies a slot out and
+/// retries if the number changed meanwhile; a writer that finds the slot
+/// busy drops its copy. No core ever waits for another.
+class LocaleCache {
+public:
+  /// Largest object kept; larger ones only use the private tier.
+  static const size_t PAYLOAD = 256;
+
+  struct slot_t {
+    std::atomic<uint64_t> seq;
+    // Cache key (see CacheTable); 0 marks an empty slot.
+    uintptr_t key;
+    uint64_t wts, rts;
+    uint32_t size;
+    char data[PAYLOAD];
+
+    slot_t() : seq(0), key(0), wts(0), rts(0), size(0) {}
+  };
+
+private:
+  slot_t* slots_;
+  size_t mask_;
+  int shift_;
+
+  static const int READ_TRIES = 4;
+
+  size_t home(uintptr_t key) const {
+    return (size_t)((key * 0x9E3779B97F4A7C15ULL) >> shift_) & mask_;
+  }
+
+  /// Take `s` for writing; false if another core is writing it.
+  static bool lock(slot_t& s, uint64_t* seq) {
+    *seq = s.seq.load(std::memory_order_relaxed);
+    if ((*seq & 1) || !s.seq.compare_exchange_strong(*seq, *seq + 1,
+          std::memory_order_acquire)) {
+      return false;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    return true;
+  }
+
+  static void unlock(slot_t& s, uint64_t seq) {
+    s.seq.store(seq + 2, std::memory_order_release);
+  }
+
+public:
+  LocaleCache() : slots_(nullptr), mask_(0), shift_(64) {}
+
+  bool initialized() const { return slots_ != nullptr; }
+  size_t capacity() const { return initialized() ? mask_ + 1 : 0; }
+  size_t bytes() const { return capacity() * sizeof(slot_t); }
+
+  /// Use the `n` slots at `slots`, which every core of the locale shares.
+  /// `n` must be a power of two.
+  void attach(slot_t* slots, size_t n) {
+    CHECK(n > 0 && (n & (n - 1)) == 0) << "locale cache size must be a power of two";
+    slots_ = slots;
+    mask_ = n - 1;
+    shift_ = 64;
+    while (n > 1) { n >>= 1; shift_--; }
+    if (shift_ == 64) shift_ = 63;
+  }
+
+  /// Copy the `size`-byte copy of `key` to `out` if there is one whose
+  /// lease reaches `pts`, and return its timestamps.
+  bool read(uintptr_t key, size_t size, uint64_t pts, void* out,
+      uint64_t* wts, uint64_t* rts) const {
+    if (size > PAYLOAD) return false;
+    slot_t& s = slots_[home(key)];
+    char buf[PAYLOAD];
+    for (int i = 0; i < READ_TRIES; i++) {
+      uint64_t seq = s.seq.load(std::memory_order_acquire);
+      if (seq & 1) continue;
+      bool match = s.key == key && s.size == size && pts <= s.rts;
+      uint64_t w = s.wts, r = s.rts;
+      if (match) memcpy(buf, s.data, size);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (s.seq.load(std::memory_order_relaxed) != seq) continue;
+      if (!match) return false;
+      memcpy(out, buf, size);
+      *wts = w;
+      *rts = r;
+      return true;
+    }
+    return false;
+  }
+
+  /// Offer a copy to the other cores. Returns false if it was not kept:
+  /// too large, the slot was busy, or it holds a newer copy already.
+  bool publish(uintptr_t key, const void* data, size_t size,
+      uint64_t wts, uint64_t rts) {
+    if (size > PAYLOAD) return false;
+    slot_t& s = slots_[home(key)];
+    uint64_t seq;
+    if (!lock(s, &seq)) return false;
+    bool keep = !(s.key == key && (s.wts > wts || (s.wts == wts && s.rts >= rts)));
+    if (keep) {
+      s.key = key;
+      s.size = size;
+      s.wts = wts;
+      s.rts = rts;
+      memcpy(s.data, data, size);
+    }
+    unlock(s, seq);
+    return keep;
+  }
+
+  /// Forget every copy.
+  void clear() {
+    if (!initialized()) return;
+    for (size_t i = 0; i <= mask_; i++) {
+      uint64_t seq;
+      // A slot being written is left to the writing core's own reset.
+      if (lock(slots_[i], &seq)) {
+        slots_[i].key = 0;
+        unlock(slots_[i], seq);
+      }
+    }
+  }
+
+  /// Slots holding a copy.
+  size_t size() const {
+    size_t n = 0;
+    for (size_t i = 0; i < capacity(); i++) n += slots_[i].key != 0;
+    return n;
+  }
+};
+
+}
+}
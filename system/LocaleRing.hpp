@@ -0,0 +1,54 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+namespace Grappa {
+namespace impl {
+
+/// Bounded single-producer, single-consumer queue of pointers between two
+/// cores of a locale (-locale_nt_rings).
+///
+/// Rings live in locale shared memory, which every core maps at the same
+/// address, so a pointer into that segment pushed by one core can be used
+/// as is by the other. Only the producer writes `tail_` and only the
+/// consumer writes `head_`; each sits on its own cache line so the two
+/// cores do not steal it from each other on every operation.
+template <size_t N>
+class LocaleRing {
+  static_assert(N > 0 && (N & (N - 1)) == 0, "ring size must be a power of two");
+
+  // Next slot to pop.
+  std::atomic<uint64_t> head_ __attribute__((aligned(64)));
+  // Next slot to push.
+  std::atomic<uint64_t> tail_ __attribute__((aligned(64)));
+  void* slots_[N] __attribute__((aligned(64)));
+
+public:
+  LocaleRing() : head_(0), tail_(0) {}
+
+  /// Producer side. False if the ring is full.
+  bool push(void* p) {
+    uint64_t t = tail_.load(std::memory_order_relaxed);
+    if (t - head_.load(std::memory_order_acquire) == N) return false;
+    slots_[t & (N - 1)] = p;
+    tail_.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// Consumer side. False if the ring is empty.
+  bool pop(void** p) {
+    uint64_t h = head_.load(std::memory_order_relaxed);
+    if (h == tail_.load(std::memory_order_acquire)) return false;
+    *p = slots_[h & (N - 1)];
+    head_.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool empty() const {
+    return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+  }
+};
+
+}
+}
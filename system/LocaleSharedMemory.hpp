@@ -89,6 +89,13 @@ public:
   }
     //#endif
 
+  // is an address in the locale shared memory?
+  inline bool contains( const void * addr ) const {
+    const char * char_base = reinterpret_cast< const char* >( base_address );
+    const char * char_addr = reinterpret_cast< const char* >( addr );
+    return (char_base <= char_addr) && (char_addr < (char_base + region_size));
+  }
+
   void * allocate( size_t size );
   void * allocate_aligned( size_t size, size_t alignment );
   void deallocate( void * ptr );
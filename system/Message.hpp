@@ -95,9 +95,9 @@ namespace Grappa {
       return &storage_;
     }
     
-    /// How much storage do we need to send this message?
+    /// How much storage do we need to send this message? (at most)
     virtual const size_t serialized_size( ) const {
-      return sizeof( &deserialize_and_call ) + sizeof( T );
+      return Grappa::impl::HandlerDictionary::max_header_size + sizeof( T );
     }
     
     virtual const size_t size() const { return sizeof(*this); }
@@ -130,33 +130,19 @@ namespace Grappa {
     }
 
     /// Copy this message into a buffer.
-    virtual char * serialize_to( char * p, size_t max_size ) {
+    virtual char * serialize_to( char * p, size_t max_size, Grappa::impl::HandlerDictionary * d = nullptr ) {
       Grappa::impl::MessageBase::serialize_to( p, max_size );
       // copy deserialization function pointer
-      auto fp = &deserialize_and_call;
-      if( serialized_size() > max_size ) {
+      auto fp = reinterpret_cast< intptr_t >( &deserialize_and_call );
+      if( header_size( d, fp ) + sizeof( T ) > max_size ) {
         return p;
       } else {
-        // // turn into 2D pointer
-        //auto gfp = make_global( fp, destination_ );
-        // // write to buffer
-        //*(reinterpret_cast< intptr_t* >(p)) = reinterpret_cast< intptr_t >( gfp );
-        //*(reinterpret_cast< intptr_t* >(p)) = reinterpret_cast< intptr_t >( fp );
-        //intptr_t gfp = reinterpret_cast< intptr_t >( fp ) << 16;
-        //gfp |= destination_; // TODO: watch out for sign extension
-        //*(reinterpret_cast< intptr_t* >(p)) = gfp;
-        // p += sizeof( fp );
-
-        MessageFPAddr gfp = { destination_, reinterpret_cast< intptr_t >( fp ) };
-        *(reinterpret_cast< MessageFPAddr* >(p)) = gfp;
-        static_assert( sizeof(gfp) == 8, "gfp wrong size?" );
-        p += sizeof( gfp );
-
+        p = write_header( d, p, fp );
         
         // copy contents
         std::memcpy( p, &storage_, sizeof(storage_) );
         
-        DVLOG(5) << __PRETTY_FUNCTION__ << " serialized message of size " << sizeof(fp) + sizeof(storage_) << " to " << gfp.dest << " with deserializer " << fp;
+        DVLOG(5) << __PRETTY_FUNCTION__ << " serialized message of size " << sizeof(storage_) << " to " << destination_ << " with deserializer " << (void*) fp;
         
         // return pointer following message
         return p + sizeof( T );
@@ -249,9 +235,10 @@ namespace Grappa {
 
 
 
-    /// How much storage do we need to send this message?
+    /// How much storage do we need to send this message? (at most)
     virtual const size_t serialized_size( ) const {
-      return sizeof( &deserialize_and_call ) + sizeof( T ) + sizeof( int16_t ) + payload_size_;
+      return Grappa::impl::HandlerDictionary::max_header_size + sizeof( T )
+        + Grappa::impl::max_varint_size + payload_size_;
     }
 
     virtual const size_t size() const { return sizeof(*this); }
@@ -270,8 +257,15 @@ namespace Grappa {
       T * obj = reinterpret_cast< T * >( t );
       t += sizeof( T );
 
-      int16_t payload_size = *(reinterpret_cast< int16_t* >(t));
-      t += sizeof( int16_t );
+      size_t payload_size;
+      if( FLAGS_compact_message_headers ) {
+        uint32_t v;
+        t = Grappa::impl::read_varint( t, &v );
+        payload_size = v;
+      } else {
+        payload_size = *(reinterpret_cast< int16_t* >(t));
+        t += sizeof( int16_t );
+      }
 
       (*obj)( t, payload_size );
 
@@ -287,40 +281,31 @@ namespace Grappa {
     }
 
     /// Copy this message into a buffer.
-    virtual char * serialize_to( char * p, size_t max_size ) {
+    virtual char * serialize_to( char * p, size_t max_size, Grappa::impl::HandlerDictionary * d = nullptr ) {
       Grappa::impl::MessageBase::serialize_to( p, max_size );
       // copy deserialization function pointer
-      auto fp = &deserialize_and_call;
-      if( serialized_size() > max_size ) {
+      auto fp = reinterpret_cast< intptr_t >( &deserialize_and_call );
+      size_t size_size = FLAGS_compact_message_headers
+        ? Grappa::impl::varint_size( payload_size_ ) : sizeof( int16_t );
+      if( header_size( d, fp ) + sizeof( T ) + size_size + payload_size_ > max_size ) {
         return p;
       } else {
-        // // turn into 2D pointer
-        // auto gfp = make_global( fp, destination_ );
-        // // write to buffer
-        // *(reinterpret_cast< intptr_t* >(p)) = reinterpret_cast< intptr_t >( gfp );
-        //*(reinterpret_cast< intptr_t* >(p)) = reinterpret_cast< intptr_t >( fp );
-
-        // intptr_t gfp = reinterpret_cast< intptr_t >( fp ) << 16;
-        // gfp |= destination_;
-        // *(reinterpret_cast< intptr_t* >(p)) = gfp;
-        // p += sizeof( fp );
-
-        MessageFPAddr gfp = { destination_, reinterpret_cast< intptr_t >( fp ) };
-        *(reinterpret_cast< MessageFPAddr* >(p)) = gfp;
-        static_assert( sizeof(gfp) == 8, "gfp wrong size?" );
-        p += sizeof( gfp );
-
+        p = write_header( d, p, fp );
         
         // copy contents
         std::memcpy( p, &storage_, sizeof(storage_) );
         p += sizeof( storage_ );
 
-        *(reinterpret_cast< int16_t* >(p)) = static_cast< int16_t >( payload_size_ );
-        p += sizeof( int16_t );
+        if( FLAGS_compact_message_headers ) {
+          p = Grappa::impl::write_varint( p, payload_size_ );
+        } else {
+          *(reinterpret_cast< int16_t* >(p)) = static_cast< int16_t >( payload_size_ );
+          p += sizeof( int16_t );
+        }
 
         std::memcpy( p, payload_, payload_size_);
 
-        DVLOG(5) << __PRETTY_FUNCTION__ << " serialized message of size " << sizeof(fp) + sizeof(storage_) + sizeof(int16_t) + payload_size_ << " to " << gfp.dest << " with deserializer " << fp;
+        DVLOG(5) << __PRETTY_FUNCTION__ << " serialized message of size " << sizeof(storage_) + size_size + payload_size_ << " to " << destination_ << " with deserializer " << (void*) fp;
 
         // return pointer following message
         return p + payload_size_;
@@ -376,6 +361,15 @@ namespace Grappa {
     return m;
   }
   
+  /// Same as send_message, with a priority for the aggregator.
+  template< typename T >
+  inline Message<T> send_message( Core dest, T t, MessagePriority p ) {
+    Message<T> m( dest, t );
+    m.set_priority( p );
+    m.enqueue();
+    return m;
+  }
+  
   /// Message with payload, immediately enqueued to be sent.
   template< typename T >
   inline PayloadMessage<T> send_message( Core dest, T t, void * payload, size_t payload_size ) {
@@ -39,6 +39,8 @@
 
 #include "ConditionVariable.hpp"
 
+DEFINE_bool( compact_message_headers, true, "Name message deserializers with 1-byte ids from a per-destination dictionary instead of 8-byte pointers, and leave out the destination (must match on all cores)" );
+
 namespace Grappa {
 
   /// Internal messaging functions
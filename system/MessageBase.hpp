@@ -47,12 +47,21 @@
 
 typedef int16_t Core;
 
+DECLARE_bool( compact_message_headers );
+
 namespace Grappa {
   
   // forward declarations
   namespace impl { class MessageBase; }
   namespace SharedMessagePool { void free(impl::MessageBase * m, size_t sz); }
   
+  /// How long a message may wait in the aggregator.
+  ///  - Normal: until its destination's buffer is full or times out
+  ///  - Urgent: under -aggregator_adaptive_flush, its destination is flushed
+  ///    as soon as it is enqueued (for requests someone is blocked on);
+  ///    otherwise the same as Normal
+  enum class MessagePriority : uint8_t { Normal, Urgent };
+
   /// Internal messaging functions
   namespace impl {
   
@@ -64,6 +73,98 @@ namespace Grappa {
     intptr_t raw;
   };
 
+  /// Deserializers already named in one destination core's stretch of an
+  /// aggregation buffer (-compact_message_headers).
+  ///
+  /// The first message with a given deserializer writes a definition
+  /// byte (0x80 | slot) followed by the full function pointer; later ones
+  /// write just the slot byte. The receiver keeps the same table while
+  /// walking the stretch, so both sides start from an empty dictionary at
+  /// each stretch. A slot is picked by hashing the pointer; two
+  /// deserializers sharing a slot just redefine it in turn.
+  class HandlerDictionary {
+  public:
+    static const int slots = 64;
+    static const uint8_t define_bit = 0x80;
+    /// Largest header a message can need.
+    static const size_t max_header_size = 1 + sizeof(intptr_t);
+
+  private:
+    intptr_t handlers_[ slots ];
+
+  public:
+    HandlerDictionary() { clear(); }
+
+    void clear() { std::memset( handlers_, 0, sizeof(handlers_) ); }
+
+    static inline int slot( intptr_t fp ) {
+      return ( static_cast< uint64_t >( fp ) * 0x9E3779B97F4A7C15ULL ) >> 58;
+    }
+
+    /// Header bytes needed to name `fp` next; `d` may be null (empty dictionary).
+    static inline size_t header_size( const HandlerDictionary * d, intptr_t fp ) {
+      return ( d && d->handlers_[ slot(fp) ] == fp ) ? 1 : max_header_size;
+    }
+
+    /// Write the header naming `fp`, defining it if needed.
+    static inline char * encode( HandlerDictionary * d, char * p, intptr_t fp ) {
+      int s = slot(fp);
+      if( d && d->handlers_[s] == fp ) {
+        *p = s;
+        return p + 1;
+      }
+      if( d ) d->handlers_[s] = fp;
+      *p = define_bit | s;
+      std::memcpy( p + 1, &fp, sizeof(fp) );
+      return p + max_header_size;
+    }
+
+    /// Read a header, returning the deserializer it names.
+    inline char * decode( char * p, intptr_t * fp ) {
+      uint8_t h = *p;
+      int s = h & ~define_bit;
+      if( h & define_bit ) {
+        std::memcpy( &handlers_[s], p + 1, sizeof(intptr_t) );
+        p += max_header_size;
+      } else {
+        p += 1;
+      }
+      *fp = handlers_[s];
+      return p;
+    }
+  };
+
+  /// Payload sizes in compact headers are LEB128 varints.
+  static const size_t max_varint_size = 3;
+
+  static inline char * write_varint( char * p, uint32_t v ) {
+    while( v >= 0x80 ) {
+      *p++ = static_cast< char >( v | 0x80 );
+      v >>= 7;
+    }
+    *p++ = static_cast< char >( v );
+    return p;
+  }
+
+  static inline char * read_varint( char * p, uint32_t * v ) {
+    uint32_t r = 0;
+    int shift = 0;
+    uint8_t b;
+    do {
+      b = *p++;
+      r |= static_cast< uint32_t >( b & 0x7f ) << shift;
+      shift += 7;
+    } while( b & 0x80 );
+    *v = r;
+    return p;
+  }
+
+  static inline size_t varint_size( uint32_t v ) {
+    size_t n = 1;
+    while( v >= 0x80 ) { v >>= 7; ++n; }
+    return n;
+  }
+
     /// @addtogroup Communication
     /// @{
 
@@ -86,6 +187,7 @@ namespace Grappa {
           bool is_sent_ : 1;           ///< Is our payload no longer needed?
           bool is_delivered_ : 1;      ///< Are we waiting to mark the message sent?
           bool is_moved_ : 1;          ///< HACK: make sure we don't try to send ourselves if we're just a temporary
+          bool is_urgent_ : 1;         ///< Should the aggregator flush our destination right away?
           Core source_ : 16;           ///< What core is this message coming from? (TODO: probably unneccesary)
           Core destination_ : 16;      ///< What core is this message aimed at?
         };
@@ -141,23 +243,53 @@ namespace Grappa {
 
       /// Interface for message serialization.
       ///  @param p Address in buffer at which to write:
-      ///    -# A 2D global address of a function that knows how to
+      ///    -# A header naming a function that knows how to
       ///       deserialize and execute the message functor/payload
       ///    -# the message functor/payload
       /// @param max_size  Largest possible serialized size
+      /// @param d  Dictionary of the destination's stretch of the buffer, or null for a message on its own
       /// @return address of the byte following the serialized message in the buffer
-      inline virtual char * serialize_to( char * p, size_t max_size = -1 ) {
+      inline virtual char * serialize_to( char * p, size_t max_size = -1, HandlerDictionary * d = nullptr ) {
         DCHECK_EQ( is_sent_, false ) << "Sending same message " << this << " multiple times?";
         is_delivered_ = true;
         return p + max_size;
       }
 
 
+      /// Bytes of header needed to name deserializer `fp` next.
+      inline size_t header_size( const HandlerDictionary * d, intptr_t fp ) const {
+        return FLAGS_compact_message_headers ? HandlerDictionary::header_size( d, fp ) : sizeof( MessageFPAddr );
+      }
+
+      /// Write the header naming deserializer `fp`. With compact headers
+      /// the destination is left out: a stretch only holds messages for
+      /// one core.
+      inline char * write_header( HandlerDictionary * d, char * p, intptr_t fp ) {
+        if( FLAGS_compact_message_headers ) {
+          return HandlerDictionary::encode( d, p, fp );
+        }
+        MessageFPAddr gfp = { destination_, fp };
+        *(reinterpret_cast< MessageFPAddr* >(p)) = gfp;
+        static_assert( sizeof(gfp) == 8, "gfp wrong size?" );
+        return p + sizeof( gfp );
+      }
+
       /// Walk a buffer of received deserializers/functors and call them.
-      static inline char * deserialize_and_call( char * buffer ) {
+      static inline char * deserialize_and_call( char * buffer, HandlerDictionary * d = nullptr ) {
         DVLOG(5) << "Deserializing message from " << (void*) buffer;
         typedef char * (*Deserializer)(char *);       // generic deserializer type
 
+        if( FLAGS_compact_message_headers ) {
+          if( d == nullptr ) {
+            HandlerDictionary single;
+            return deserialize_and_call( buffer, &single );
+          }
+          intptr_t fp;
+          buffer = d->decode( buffer, &fp );
+          CHECK( fp != 0 ) << "Message names an undefined deserializer slot! buffer=" << (void*) buffer;
+          return reinterpret_cast< Deserializer >( fp )( buffer );
+        }
+
         // intptr_t gfp = *(reinterpret_cast< intptr_t* >( buffer ));
         // Core dest = gfp & ((1 << 16) - 1);
         // Deserializer fp = *(reinterpret_cast< Deserializer* >( gfp >> 16 ));
@@ -190,6 +322,7 @@ namespace Grappa {
         , is_sent_( false )
         , is_delivered_( false )
         , is_moved_( false )
+        , is_urgent_( false )
         // , reset_count_(0)
         , delete_after_send_( false ) 
       { 
@@ -204,6 +337,7 @@ namespace Grappa {
         , is_sent_( false )
         , is_delivered_( false )
         , is_moved_( false )
+        , is_urgent_( false )
         , source_( -1 )
         , destination_( dest )
         // , reset_count_(0)
@@ -232,6 +366,7 @@ namespace Grappa {
         , is_sent_( m.is_sent_ )
         , is_delivered_( m.is_delivered_ )
         , is_moved_( false ) // this only tells us if the current message has been moved
+        , is_urgent_( m.is_urgent_ )
         , source_( m.source_ )
         , destination_( m.destination_ )
         // , reset_count_(0)
@@ -269,6 +404,10 @@ namespace Grappa {
         delete_after_send_ = true;
       }
 
+      inline void set_priority( MessagePriority p ) {
+        is_urgent_ = ( p == MessagePriority::Urgent );
+      }
+
 
       virtual void reset() {
         // if( reset_count_ > 0 ) {
@@ -1,10 +1,83 @@
-
 #include "NTBuffer.hpp"
+#include "Metrics.hpp"
+
+#include <string.h>
+#include <sys/mman.h>
+
+DEFINE_int64( nt_buffer_pool_size, 16, "Number of NT message buffers each core keeps for reuse" );
+
+/// NT buffers taken from the pool, and those it had to allocate
+GRAPPA_DEFINE_METRIC( SimpleMetric<int64_t>, nt_buffer_pool_hits, 0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<int64_t>, nt_buffer_pool_misses, 0 );
 
 namespace Grappa {
 namespace impl {
 
 int NTBuffer::initial_offset = 0;
 
+NTBufferPool nt_buffer_pool;
+NTSharedBudget nt_shared_budget;
+
+static const size_t HUGE_PAGE_SIZE = 1 << 21;
+
+NTBufferPool::~NTBufferPool() {
+  if( base_ ) munmap( base_, bytes_ );
+}
+
+void NTBufferPool::init( size_t buffers ) {
+  CHECK( base_ == nullptr ) << "NT buffer pool initialized twice";
+  if( buffers == 0 ) return;
+
+  // over-reserve so the buffers can start on a huge page boundary
+  bytes_ = buffers * BUFFER_SIZE + HUGE_PAGE_SIZE;
+  void * p = mmap( nullptr, bytes_, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0 );
+  CHECK( p != MAP_FAILED ) << "NT buffer pool: cannot reserve " << bytes_ << " bytes";
+  char * start = reinterpret_cast< char * >( p );
+  char * aligned = reinterpret_cast< char * >(
+    (reinterpret_cast< uintptr_t >( start ) + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1) );
+#ifdef MADV_HUGEPAGE
+  // only a hint; without transparent huge pages we get normal pages
+  madvise( aligned, buffers * BUFFER_SIZE, MADV_HUGEPAGE );
+#endif
+
+  // give back the slack in front of the aligned part
+  if( aligned != start ) munmap( start, aligned - start );
+  base_ = aligned;
+  bytes_ -= aligned - start;
+  capacity_ = buffers;
+  carved_ = 0;
+  free_.reserve( buffers );
+}
+
+void * NTBufferPool::take() {
+  if( !free_.empty() ) {
+    nt_buffer_pool_hits++;
+    void * p = free_.back();
+    free_.pop_back();
+    return p;
+  }
+
+  nt_buffer_pool_misses++;
+  if( carved_ < capacity_ ) {
+    char * p = base_ + carved_++ * BUFFER_SIZE;
+    memset( p, 0, BUFFER_SIZE ); // fault it in now rather than while filling it
+    return p;
+  }
+
+  void * p = nullptr;
+  CHECK( posix_memalign( &p, 64, BUFFER_SIZE ) == 0 )
+    << "posix_memalign error: buffer allocation failed";
+  return p;
+}
+
+void NTBufferPool::give( void * p ) {
+  if( owns( p ) ) {
+    free_.push_back( p );
+  } else {
+    free( p );
+  }
+}
+
 } // namespace impl
 } // namespace Grappa
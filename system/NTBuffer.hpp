@@ -36,15 +36,115 @@
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 
+#include <atomic>
 #include <tuple>
+#include <new>
+#include <vector>
 
 #include <x86intrin.h>
 
+#include "LocaleSharedMemory.hpp"
+
 #define BUFFER_SIZE (1 << 19)
 
 namespace Grappa {
 namespace impl {
 
+/// Recycles this core's NT data buffers (-nt_buffer_pool_size).
+///
+/// The pool reserves room for a fixed number of buffers in one mapping,
+/// backed by transparent huge pages where the kernel allows it, and
+/// faults each buffer in the first time it is handed out. A buffer given
+/// back after its send completes is reused without allocating or
+/// faulting again. When every pooled buffer is in flight, buffers come
+/// from posix_memalign and are freed when given back, so the pool never
+/// grows past its reservation.
+class NTBufferPool {
+  char * base_;
+  size_t bytes_;
+  size_t capacity_;
+  // buffers handed out at least once
+  size_t carved_;
+  std::vector< void * > free_;
+
+public:
+  NTBufferPool()
+    : base_( nullptr )
+    , bytes_( 0 )
+    , capacity_( 0 )
+    , carved_( 0 )
+    , free_()
+  { }
+
+  ~NTBufferPool();
+
+  /// Reserve room for `buffers` buffers.
+  void init( size_t buffers );
+
+  inline bool owns( const void * p ) const {
+    const char * c = static_cast< const char * >( p );
+    return base_ <= c && c < base_ + capacity_ * BUFFER_SIZE;
+  }
+
+  void * take();
+  void give( void * p );
+
+  size_t capacity() const { return capacity_; }
+  size_t free_count() const { return free_.size(); }
+};
+
+/// this core's pool
+extern NTBufferPool nt_buffer_pool;
+
+/// Bounds the locale shared memory held by NT buffers for cores of this
+/// locale (-locale_nt_buffer_bytes per sending core).
+///
+/// Each core of the locale has a byte count in locale shared memory. A
+/// sender charges a buffer to its own count before allocating it there,
+/// and whoever frees the buffer (the receiving core, or the sender once an
+/// MPI send of it completes) gives the bytes back. A sender over budget
+/// fills a private buffer instead, which goes through MPI.
+class NTSharedBudget {
+  std::atomic< int64_t > * bytes_;
+  int64_t limit_;
+  int mine_;
+
+public:
+  NTSharedBudget()
+    : bytes_( nullptr )
+    , limit_( 0 )
+    , mine_( 0 )
+  { }
+
+  /// `bytes` has one count per core of the locale; `mine` is this core's.
+  void init( std::atomic< int64_t > * bytes, int64_t limit, int mine ) {
+    bytes_ = bytes;
+    limit_ = limit;
+    mine_ = mine;
+  }
+
+  /// Charge one buffer to this core; false if that would exceed its budget.
+  bool take() {
+    if( !bytes_ ) return false;
+    if( bytes_[ mine_ ].fetch_add( BUFFER_SIZE ) + BUFFER_SIZE > limit_ ) {
+      bytes_[ mine_ ].fetch_sub( BUFFER_SIZE );
+      return false;
+    }
+    return true;
+  }
+
+  /// Give back a buffer charged to core `owner` of the locale.
+  void give( int owner ) {
+    if( bytes_ ) bytes_[ owner ].fetch_sub( BUFFER_SIZE );
+  }
+  void give() { give( mine_ ); }
+
+  int64_t held( int owner ) const { return bytes_[ owner ].load(); }
+};
+
+/// this core's share of the locale's NT buffer budget
+extern NTSharedBudget nt_shared_budget;
+
 class NTBuffer {
   static const int local_buffer_size = 8;
   static const int last_position = 7;
@@ -64,6 +164,10 @@ class NTBuffer {
   uint64_t * buffer_;
   int position_;
   int local_position_;
+
+  // Allocate data buffers in locale shared memory, so they can be handed
+  // to a core of this locale without copying (see LocaleRing).
+  bool locale_shared_;
   
 public:
   NTBuffer()
@@ -71,6 +175,7 @@ public:
     , buffer_( nullptr )
     , position_( 0 )
     , local_position_( 0 )
+    , locale_shared_( false )
   { }
 
   inline bool empty() const { return position_ == 0 && local_position_ == 0; }
@@ -79,11 +184,21 @@ public:
     initial_offset = words;
   }
 
+  void set_locale_shared( bool shared ) {
+    locale_shared_ = shared;
+  }
+
   void new_buffer( ) {
     DVLOG(5) << "Allocating new buffer for " << this;
-    CHECK( posix_memalign( reinterpret_cast<void**>(&buffer_), 64, BUFFER_SIZE ) == 0 )
-      << "posix_memalign error: buffer allocation failed";
     position_ = 0;
+    if( locale_shared_ && nt_shared_budget.take() ) {
+      // fall back to private memory if the shared segment is exhausted
+      buffer_ = reinterpret_cast<uint64_t*>(
+        locale_shared_memory.segment.allocate_aligned( BUFFER_SIZE, 64, std::nothrow ) );
+      if( buffer_ ) return;
+      nt_shared_budget.give();
+    }
+    buffer_ = reinterpret_cast<uint64_t*>( nt_buffer_pool.take() );
   }
   
   std::tuple< void *, int > take_buffer() {
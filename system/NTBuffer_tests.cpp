@@ -72,4 +72,52 @@ BOOST_AUTO_TEST_CASE( test1 ) {
   }
 }
 
+BOOST_AUTO_TEST_CASE( pool ) {
+  Grappa::impl::NTBufferPool pool;
+  pool.init( 2 );
+
+  // two buffers from the pool, then one from the heap
+  void * a = pool.take();
+  void * b = pool.take();
+  void * c = pool.take();
+  BOOST_CHECK( pool.owns( a ) );
+  BOOST_CHECK( pool.owns( b ) );
+  BOOST_CHECK( !pool.owns( c ) );
+  BOOST_CHECK_EQUAL( reinterpret_cast<uintptr_t>( a ) % 64, 0 );
+
+  // only pooled buffers are kept
+  pool.give( a );
+  pool.give( c );
+  pool.give( b );
+  BOOST_CHECK_EQUAL( pool.free_count(), 2 );
+
+  // and reused
+  void * d = pool.take();
+  BOOST_CHECK( d == a || d == b );
+  BOOST_CHECK_EQUAL( pool.free_count(), 1 );
+  pool.give( d );
+}
+
+BOOST_AUTO_TEST_CASE( shared_budget ) {
+  std::atomic< int64_t > bytes[2];
+  bytes[0] = bytes[1] = 0;
+  Grappa::impl::NTSharedBudget budget;
+  BOOST_CHECK( !budget.take() );
+  budget.init( bytes, 2 * BUFFER_SIZE, 1 );
+
+  // two buffers fit, a third does not
+  BOOST_CHECK( budget.take() );
+  BOOST_CHECK( budget.take() );
+  BOOST_CHECK( !budget.take() );
+  BOOST_CHECK_EQUAL( budget.held( 1 ), 2 * BUFFER_SIZE );
+  BOOST_CHECK_EQUAL( budget.held( 0 ), 0 );
+
+  // a receiver freeing one makes room again
+  budget.give( 1 );
+  BOOST_CHECK( budget.take() );
+  budget.give();
+  budget.give();
+  BOOST_CHECK_EQUAL( budget.held( 1 ), 0 );
+}
+
 BOOST_AUTO_TEST_SUITE_END();
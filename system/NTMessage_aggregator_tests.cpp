@@ -128,6 +128,30 @@ BOOST_AUTO_TEST_CASE( test1 ) {
         BOOST_CHECK_EQUAL( 1, 1 );
       }
 
+      { // cores of one locale pass buffers through the locale rings
+        int64_t sends = nt_locale_ring_sends.value();
+        int x = 0;
+        Grappa::CompletionEvent ce(2);
+        Grappa::impl::global_rdma_aggregator.send_nt_message( 1, [&x,&ce] {
+            Grappa::impl::global_rdma_aggregator.send_nt_message( 0, [&x,&ce] {
+                x++;
+                ce.complete();
+              } );
+            Grappa::impl::global_rdma_aggregator.flush_nt( 0 );
+          } );
+        Grappa::impl::global_rdma_aggregator.send_nt_message( 0, [&x,&ce] {
+            x++;
+            ce.complete();
+          } );
+        Grappa::impl::global_rdma_aggregator.flush_nt( 1 );
+        Grappa::impl::global_rdma_aggregator.flush_nt( 0 );
+        ce.wait();
+        BOOST_CHECK_EQUAL( x, 2 );
+        if( FLAGS_locale_nt_rings && Grappa::locale_of( 1 ) == Grappa::mylocale() ) {
+          BOOST_CHECK_GE( nt_locale_ring_sends.value() - sends, 2 );
+        }
+      }
+
     });
   Grappa::finalize();
 }
@@ -0,0 +1,97 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <new>
+#include <unordered_map>
+#include <sys/mman.h>
+#include <glog/logging.h>
+
+namespace Grappa {
+namespace impl {
+
+/// Owner-side coherence metadata of the objects a core owns.
+///
+/// Objects in this core's share of the global heap get their metadata from
+/// a shadow array with one slot per `BLOCK` bytes of the heap, found by
+/// pointer arithmetic on the object's local address. The array is reserved
+/// up front but only backed by memory where it is touched, so it costs
+/// nothing for untouched parts of the heap and never grows.
+///
+/// Metadata is kept per block: callers pass the block's key (see
+/// GlobalAddress::find_owner_info), so every object starting in a block
+/// shares that block's slot. Only addresses outside the heap (2D addresses
+/// of stack or static data) fall back to a hash map.
+///
+/// References returned by `find` stay valid until `clear`.
+template <typename O, size_t BLOCK = 64>
+class OwnerTable {
+  struct slot_t {
+    // Complement of the key, so that untouched (zero) memory is a free slot
+    // whatever keys are in use: it stands for key ~0, which no address has.
+    uintptr_t not_key;
+    O info;
+  };
+
+  const char* base_;
+  size_t bytes_;
+  slot_t* slots_;
+  size_t map_bytes_;
+  size_t used_;
+  std::unordered_map<uintptr_t, O> overflow_;
+
+public:
+  OwnerTable() : base_(nullptr), bytes_(0), slots_(nullptr), map_bytes_(0),
+    used_(0) {}
+
+  ~OwnerTable() {
+    if (slots_ != nullptr) munmap(slots_, map_bytes_);
+  }
+
+  bool initialized() const { return slots_ != nullptr; }
+
+  /// Shadow the `bytes` of local memory starting at `base`.
+  void init(const void* base, size_t bytes) {
+    CHECK(!initialized());
+    base_ = static_cast<const char*>(base);
+    bytes_ = bytes;
+    map_bytes_ = (bytes / BLOCK + 1) * sizeof(slot_t);
+    void* p = mmap(nullptr, map_bytes_, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    CHECK(p != MAP_FAILED) << "owner table: cannot reserve " << map_bytes_ << " bytes";
+    slots_ = static_cast<slot_t*>(p);
+  }
+
+  /// Metadata of the object `key` whose storage starts at `local`,
+  /// default-constructed on first use.
+  O& find(uintptr_t key, const void* local) {
+    size_t offset = static_cast<const char*>(local) - base_;
+    if (offset < bytes_) {
+      slot_t& s = slots_[offset / BLOCK];
+      if (s.not_key == ~key) return s.info;
+      if (s.not_key == 0) {
+        s.not_key = ~key;
+        new (&s.info) O();
+        used_++;
+        return s.info;
+      }
+    }
+    return overflow_[key];
+  }
+
+  /// Forget every entry.
+  void clear() {
+    if (initialized() && used_ > 0) {
+      // Hands the pages back; they read as zeroes (free slots) again.
+      madvise(slots_, map_bytes_, MADV_DONTNEED);
+    }
+    used_ = 0;
+    overflow_.clear();
+  }
+
+  /// Entries in the shadow array, and in the fallback map.
+  size_t size() const { return used_ + overflow_.size(); }
+  size_t overflow() const { return overflow_.size(); }
+};
+
+}
+}
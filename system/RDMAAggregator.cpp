@@ -60,6 +60,7 @@ DEFINE_int64( aggregator_target_size, 1 << 10, "Target size for aggregated messa
 
 DECLARE_int64( log2_concurrent_receives );
 DECLARE_int64( log2_concurrent_sends );
+DECLARE_int64( nt_buffer_pool_size );
 
 DEFINE_int64( rdma_workers_per_core, 1 << 6, "Number of RDMA deaggregation worker threads" );
 DEFINE_int64( rdma_buffers_per_core, 1 << 7, "Number of RDMA aggregated message buffers per core" );
@@ -70,6 +71,12 @@ DEFINE_string( route_graph_filename, "", "Name of file for routing graph output
 
 DEFINE_bool( rdma_flush_on_idle, true, "Flush RDMA buffers when idle" );
 
+DEFINE_bool( aggregator_adaptive_flush, false, "Choose each locale's flush timeout and size from its traffic and the observed delegate latency" );
+DEFINE_int64( aggregator_min_flush_ticks, 5000, "Shortest flush timeout the adaptive flush policy may choose" );
+
+DEFINE_bool( locale_nt_rings, true, "Hand NT message buffers to cores of the same locale through shared-memory rings instead of MPI" );
+DEFINE_int64( locale_nt_buffer_bytes, 16 * BUFFER_SIZE, "Locale shared memory each core may hold at once in NT buffers for cores of its locale" );
+
 /// stats for application messages
 GRAPPA_DEFINE_METRIC( SimpleMetric<int64_t>, app_messages_enqueue, 0 );
 GRAPPA_DEFINE_METRIC( SimpleMetric<int64_t>, app_messages_enqueue_cas, 0 );
@@ -82,6 +89,12 @@ GRAPPA_DEFINE_METRIC( SimpleMetric<int64_t>, app_messages_deserialized, 0 );
 GRAPPA_DEFINE_METRIC( SummarizingMetric<int64_t>, app_nt_message_bytes, 0 );
 GRAPPA_DEFINE_METRIC( SummarizingMetric<int64_t>, aggregated_nt_message_bytes, 0 );
 
+/// NT buffers handed to a core of this locale through its ring, and those
+/// that went through MPI because the ring was full
+GRAPPA_DEFINE_METRIC( SimpleMetric<int64_t>, nt_locale_ring_sends, 0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<int64_t>, nt_locale_ring_receives, 0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<int64_t>, nt_locale_ring_full, 0 );
+
 GRAPPA_DEFINE_METRIC( SummarizingMetric<int64_t>, app_messages_delivered_locally, 0 );
 GRAPPA_DEFINE_METRIC( SummarizingMetric<int64_t>, app_bytes_delivered_locally, 0 );
 
@@ -103,6 +116,7 @@ GRAPPA_DEFINE_METRIC( SimpleMetric<int64_t>, rdma_capacity_flushes, 0 );
 GRAPPA_DEFINE_METRIC( SimpleMetric<int64_t>, rdma_idle_flushes, 0 );
 GRAPPA_DEFINE_METRIC( SimpleMetric<int64_t>, rdma_core_idle_flushes, 0 );
 GRAPPA_DEFINE_METRIC( SimpleMetric<int64_t>, rdma_requested_flushes, 0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<int64_t>, rdma_urgent_flushes, 0 );
 
 GRAPPA_DEFINE_METRIC( SummarizingMetric<int64_t>, rdma_buffers_inuse, 0 );
 GRAPPA_DEFINE_METRIC( SimpleMetric<int64_t>, rdma_buffers_blocked, 0 );
@@ -303,6 +317,7 @@ namespace Grappa {
       // where can NTBuffer start storing data?
       NTBuffer::set_initial_offset( 4 ); // TODO: for now we say 32 bytes.
       ntbuffers_ = new NTBuffer[ global_communicator.cores ];
+      nt_buffer_pool.init( FLAGS_nt_buffer_pool_size );
     }
     
     size_t RDMAAggregator::estimate_footprint() const {
@@ -334,6 +349,13 @@ namespace Grappa {
           // allocate routing info
           source_core_for_locale_ = Grappa::impl::locale_shared_memory.segment.construct<Core>("SourceCores")[global_communicator.locales]();
           dest_core_for_locale_ = Grappa::impl::locale_shared_memory.segment.construct<Core>("DestCores")[global_communicator.locales]();
+
+          // one ring for each ordered pair of cores on this locale
+          if( FLAGS_locale_nt_rings ) {
+            nt_rings_ = Grappa::impl::locale_shared_memory.segment.construct<NTRing>("NTRings")[global_communicator.locale_cores *
+                                                                                                global_communicator.locale_cores]();
+            Grappa::impl::locale_shared_memory.segment.construct< std::atomic<int64_t> >("NTSharedBytes")[global_communicator.locale_cores](0);
+          }
         }
         catch(...){
           failure_function();
@@ -362,6 +384,13 @@ namespace Grappa {
           q = Grappa::impl::locale_shared_memory.segment.find<Core>("DestCores");
           CHECK_EQ( q.second, global_communicator.locales );
           dest_core_for_locale_ = q.first;
+
+          if( FLAGS_locale_nt_rings ) {
+            std::pair< NTRing *, boost::interprocess::managed_shared_memory::size_type > r;
+            r = Grappa::impl::locale_shared_memory.segment.find<NTRing>("NTRings");
+            CHECK_EQ( r.second, global_communicator.locale_cores * global_communicator.locale_cores );
+            nt_rings_ = r.first;
+          }
         }
         catch(...){
           failure_function();
@@ -373,6 +402,16 @@ namespace Grappa {
       // what locales is my core responsible for?
       //
 
+      // NT buffers for cores of this locale are allocated where those cores can read them
+      if( nt_rings_ ) {
+        auto bytes = Grappa::impl::locale_shared_memory.segment.find< std::atomic<int64_t> >("NTSharedBytes");
+        CHECK_EQ( bytes.second, global_communicator.locale_cores );
+        nt_shared_budget.init( bytes.first, FLAGS_locale_nt_buffer_bytes, global_communicator.locale_mycore );
+        for( Core c = 0; c < global_communicator.cores; ++c ) {
+          ntbuffers_[c].set_locale_shared( global_communicator.locale_of(c) == global_communicator.mylocale );
+        }
+      }
+
       // draw route map if enabled
       draw_routing_graph();
 
@@ -383,6 +422,7 @@ namespace Grappa {
 
       // generate list of locales this core is responsible for
       core_partner_locales_ = new Locale[ locales_per_core ];
+      flush_rates_ = new FlushRate[ Grappa::locales() ]();
       for( int i = 0; i < Grappa::locales(); ++i ) {
         if( source_core_for_locale_[i] == Grappa::mycore() ) {
           CHECK_LT( core_partner_locale_count_, locales_per_core ) << "this core is responsible for more locales than expected";
@@ -466,12 +506,20 @@ namespace Grappa {
         Grappa::impl::locale_shared_memory.segment.destroy<CoreData>("Cores");
         Grappa::impl::locale_shared_memory.segment.destroy<Core>("SourceCores");
         Grappa::impl::locale_shared_memory.segment.destroy<Core>("DestCores");
+        if( nt_rings_ ) {
+          Grappa::impl::locale_shared_memory.segment.destroy<NTRing>("NTRings");
+          Grappa::impl::locale_shared_memory.segment.destroy< std::atomic<int64_t> >("NTSharedBytes");
+        }
       }
       cores_ = NULL;
+      nt_rings_ = nullptr;
+      nt_shared_budget.init( nullptr, 0, 0 );
       source_core_for_locale_ = NULL;
       dest_core_for_locale_ = NULL;
 
       if( core_partner_locales_ ) delete [] core_partner_locales_;
+      if( flush_rates_ ) delete [] flush_rates_;
+      flush_rates_ = nullptr;
       Grappa::impl::locale_shared_memory.deallocate( rdma_buffers_ );
 #endif
     }
@@ -570,10 +618,16 @@ void RDMAAggregator::draw_routing_graph() {
 
 
 
-    char * RDMAAggregator::aggregate_to_buffer( char * buffer, Grappa::impl::MessageBase ** message_ptr, size_t max, uint64_t * count_p ) {
+    char * RDMAAggregator::aggregate_to_buffer( char * buffer, Grappa::impl::MessageBase ** message_ptr, size_t max, uint64_t * count_p,
+                                                Grappa::impl::HandlerDictionary * dictionary ) {
       size_t size = 0;
       size_t count = 0;
 
+      if( dictionary == nullptr ) {
+        Grappa::impl::HandlerDictionary fresh;
+        return aggregate_to_buffer( buffer, message_ptr, max, count_p, &fresh );
+      }
+
       Grappa::impl::MessageBase * message = *message_ptr;
       DVLOG(5) << "Serializing messages from " << message;
 
@@ -588,7 +642,7 @@ void RDMAAggregator::draw_routing_graph() {
         __builtin_prefetch( pf + 64, 1, prefetch_type );
 #endif
         // add message to buffer
-        char * new_buffer = message->serialize_to( buffer, max - size);
+        char * new_buffer = message->serialize_to( buffer, max - size, dictionary );
 
         if( new_buffer == buffer ) { // if it was too big
           DVLOG(5) << __func__ << ": Message too big: aborting serialization";
@@ -633,10 +687,11 @@ void RDMAAggregator::draw_routing_graph() {
     char * RDMAAggregator::deaggregate_buffer( char * buffer, size_t size ) {
       DVLOG(5) << __func__ << ": Deaggregating buffer at " << (void*) buffer << " of max size " << size;
       char * end = buffer + size;
+      Grappa::impl::HandlerDictionary dictionary;
       while( buffer < end ) {
         app_messages_deserialized++;
         DVLOG(5) << __func__ << ": Deserializing and calling at " << (void*) buffer << " with " << end - buffer << " remaining";
-        char * next = Grappa::impl::MessageBase::deserialize_and_call( buffer );
+        char * next = Grappa::impl::MessageBase::deserialize_and_call( buffer, &dictionary );
         DVLOG(5) << __func__ << ": Deserializing and called at " << (void*) buffer << " with next " << (void*) next;
         buffer = next;
       }
@@ -807,6 +862,29 @@ void RDMAAggregator::draw_routing_graph() {
     Grappa::impl::global_scheduler.set_no_switch_region( false );
   }
 
+  bool RDMAAggregator::receive_nt_rings() {
+    // receive_nt_buffer ends with the no-switch region off, so not from inside one
+    if( Grappa::impl::global_scheduler.in_no_switch_region() ) return false;
+
+    bool received = false;
+    Core mycore = Grappa::mycore();
+    Core first = Grappa::mylocale() * Grappa::locale_cores();
+    for( Core source = first; source < first + Grappa::locale_cores(); ++source ) {
+      NTRing * ring = nt_ring( source, mycore );
+      void * p;
+      while( ring->pop( &p ) ) {
+        auto b = reinterpret_cast<RDMABuffer*>( p );
+        DVLOG(3) << "Received NT buffer " << b << " from core " << source << " through locale ring";
+        receive_nt_buffer( b );
+        Grappa::impl::locale_shared_memory.segment.deallocate( b );
+        nt_shared_budget.give( source - first );
+        nt_locale_ring_receives++;
+        received = true;
+      }
+    }
+    return received;
+  }
+
 
 
   void RDMAAggregator::receive_buffer( RDMABuffer * buf ) {
@@ -1161,6 +1239,10 @@ void RDMAAggregator::draw_routing_graph() {
 
       int64_t count = 0;
 
+      // each core's stretch of the buffer names deserializers from its own dictionary
+      Grappa::impl::HandlerDictionary dictionary;
+      Core dictionary_core = -1;
+
       DVLOG(4) << __func__ << "/" << sequence_number << ": " << "Preparing an active message in buffer " << b << " for locale " << locale;
 
       // fill the buffer
@@ -1204,7 +1286,12 @@ void RDMAAggregator::draw_routing_graph() {
           Grappa::impl::MessageBase * prev_messages_to_send = messages_to_send;
           CHECK_EQ( messages_to_send->destination_, current_dest_core ) << "hmm. this doesn't seem right";
           static_assert(sizeof(size_t) == sizeof(uint64_t), "must be 64-bit");
-          char * end = aggregate_to_buffer( current_buf, &messages_to_send, remaining_size, &aggregate_counts_[current_dest_core] );
+          if( dictionary_core != current_dest_core ) {
+            dictionary.clear();
+            dictionary_core = current_dest_core;
+          }
+          char * end = aggregate_to_buffer( current_buf, &messages_to_send, remaining_size, &aggregate_counts_[current_dest_core],
+                                            &dictionary );
           size_t current_aggregated_size = end - current_buf;
           CHECK_LE( aggregated_size + current_aggregated_size, max_size );
           CHECK_GE( remaining_size, 0 );
@@ -1310,6 +1397,7 @@ void RDMAAggregator::draw_routing_graph() {
     CHECK_NULL( messages_to_send );
 
     rdma_bytes_sent_histogram = bytes_sent;
+    update_flush_policy( locale, bytes_sent );
 
     active_send_workers_--;
     rdma_send_end++;
@@ -1317,6 +1405,37 @@ void RDMAAggregator::draw_routing_graph() {
   }
 
 
+  void RDMAAggregator::update_flush_policy( Locale locale, int64_t bytes_sent ) {
+    if( !FLAGS_aggregator_adaptive_flush ) return;
+
+    FlushRate & r = flush_rates_[ locale ];
+    Grappa::Timestamp now = Grappa::timestamp();
+    if( r.last_send != 0 && now > r.last_send ) {
+      double sample = static_cast<double>( bytes_sent ) / ( now - r.last_send );
+      r.bytes_per_tick = 0.75 * r.bytes_per_tick + 0.25 * sample;
+    }
+    r.last_send = now;
+
+    // how long may messages wait, and how much arrives meanwhile?
+    double budget = FLAGS_aggregator_autoflush_ticks;
+    if( round_trip_ticks_ > 0 ) budget = std::min( budget, round_trip_ticks_ / 4 );
+    double expected = r.bytes_per_tick * budget;
+
+    double ticks = budget;
+    double bytes = std::min< double >( expected, max_size_ );
+    if( expected < FLAGS_aggregator_target_size ) {
+      // waiting the whole budget would not fill a buffer anyway
+      ticks = budget * expected / FLAGS_aggregator_target_size;
+      bytes = FLAGS_aggregator_target_size;
+    }
+
+    CoreData * locale_core = localeCoreData( locale * Grappa::locale_cores() );
+    locale_core->flush_ticks_ = std::max< double >( ticks, FLAGS_aggregator_min_flush_ticks );
+    locale_core->flush_bytes_ = bytes;
+    DVLOG(3) << "Flush policy for locale " << locale << ": " << locale_core->flush_ticks_
+             << " ticks, " << locale_core->flush_bytes_ << " bytes";
+  }
+
   void RDMAAggregator::send_nt_buffer( Core dest, NTBuffer * buf ) {
     nt_mru_.reset(dest);
     auto buftuple = buf->take_buffer();
@@ -1333,16 +1452,38 @@ void RDMAAggregator::draw_routing_graph() {
     b->set_source( Grappa::mycore() );
     b->set_ack( reinterpret_cast<RDMABuffer*>(-1) ); // TODO: magic number for now
     b->deserializer = (void*) &enqueue_buffer_am;
+    aggregated_nt_message_bytes += size;
+
+    // cores of this locale can read a buffer in locale shared memory
+    // directly, so just pass them the pointer
+    if( nt_rings_ && global_communicator.locale_of( dest ) == global_communicator.mylocale
+        && Grappa::impl::locale_shared_memory.contains( b ) ) {
+      if( nt_ring( Grappa::mycore(), dest )->push( b ) ) {
+        DVLOG(3) << "Handing NT buffer " << b << " to core " << dest << " through locale ring";
+        nt_locale_ring_sends++;
+        if( !global_scheduler.in_no_switch_region() ) {
+          Grappa::impl::global_scheduler.thread_yield();
+        }
+        return;
+      }
+      // ring is full; go through MPI instead
+      nt_locale_ring_full++;
+    }
+
     b->context.callback = [] ( CommunicatorContext * c, int source, int tag, int received_size ) {
       DVLOG(4) << "Got callback for " << c;
-      free( c->buf );
+      if( Grappa::impl::locale_shared_memory.contains( c->buf ) ) {
+        Grappa::impl::locale_shared_memory.segment.deallocate( c->buf );
+        nt_shared_budget.give();
+      } else {
+        nt_buffer_pool.give( c->buf );
+      }
     };
     b->context.buf = (void*) b;
     b->context.size = b->get_max_size();
     b->context.reference_count = 1;
     DVLOG(3) << "Sending " << &b->context << " with deserializer " << (void*) &enqueue_buffer_am;
     global_communicator.post_external_send( &b->context, dest, size );
-    aggregated_nt_message_bytes += size;
     
     // give ourselves a chance to receive something
     if( !global_scheduler.in_no_switch_region() ) {
@@ -64,6 +64,7 @@
 
 #include "NTMessage.hpp"
 #include "NTBuffer.hpp"
+#include "LocaleRing.hpp"
 
 // #include <boost/interprocess/containers/vector.hpp>
 
@@ -71,6 +72,8 @@ DECLARE_int64( target_size );
 DECLARE_int64( aggregator_target_size );
 DECLARE_int64( aggregator_autoflush_ticks );
 DECLARE_bool( enable_aggregation );
+DECLARE_bool( locale_nt_rings );
+DECLARE_bool( aggregator_adaptive_flush );
 
 /// stats for application messages
 GRAPPA_DECLARE_METRIC( SimpleMetric<int64_t>, app_messages_enqueue );
@@ -78,10 +81,13 @@ GRAPPA_DECLARE_METRIC( SimpleMetric<int64_t>, app_messages_enqueue_cas );
 GRAPPA_DECLARE_METRIC( SimpleMetric<int64_t>, app_messages_immediate );
 
 GRAPPA_DECLARE_METRIC( SummarizingMetric<int64_t>, app_nt_message_bytes );
+GRAPPA_DECLARE_METRIC( SimpleMetric<int64_t>, nt_locale_ring_sends );
+GRAPPA_DECLARE_METRIC( SimpleMetric<int64_t>, nt_locale_ring_receives );
 
 /// stats for RDMA Aggregator events
 GRAPPA_DECLARE_METRIC( SimpleMetric<int64_t>, rdma_capacity_flushes );
 GRAPPA_DECLARE_METRIC( SimpleMetric<int64_t>, rdma_requested_flushes );
+GRAPPA_DECLARE_METRIC( SimpleMetric<int64_t>, rdma_urgent_flushes );
 
 GRAPPA_DECLARE_METRIC( SimpleMetric<int64_t>, rdma_poll );
 GRAPPA_DECLARE_METRIC( SimpleMetric<int64_t>, rdma_poll_send );
@@ -212,7 +218,13 @@ namespace Grappa {
       size_t locale_byte_count_;
       Grappa::Timestamp earliest_message_for_locale_;
 
-      int64_t pad2[7];
+      /// flush timeout and size for this locale, chosen by its source
+      /// core under -aggregator_adaptive_flush and read racily by the
+      /// other cores
+      Grappa::Timestamp flush_ticks_;
+      size_t flush_bytes_;
+
+      int64_t pad2[5];
 
       
       CoreData() 
@@ -225,6 +237,8 @@ namespace Grappa {
         , remote_buffers_()
         , locale_byte_count_(0)
         , earliest_message_for_locale_(0)
+        , flush_ticks_( FLAGS_aggregator_autoflush_ticks )
+        , flush_bytes_( FLAGS_aggregator_target_size )
       { }
     } __attribute__ ((aligned(64)));
 
@@ -247,6 +261,18 @@ namespace Grappa {
       NTBuffer * ntbuffers_;
       boost::dynamic_bitset<> nt_mru_;
 
+      /// Rings carrying NT buffers between the cores of this locale, one
+      /// per (source, destination) pair, in locale shared memory
+      /// (-locale_nt_rings). Null when disabled. The buffers themselves
+      /// are bounded by nt_shared_budget.
+      typedef LocaleRing< 16 > NTRing;
+      NTRing * nt_rings_;
+
+      inline NTRing * nt_ring( Core source, Core dest ) const {
+        Core first = Grappa::mylocale() * Grappa::locale_cores();
+        return &nt_rings_[ (dest - first) * Grappa::locale_cores() + (source - first) ];
+      }
+
       void compute_route_map();
       void draw_routing_graph();
       void fill_free_pool( size_t num_buffers );
@@ -293,6 +319,10 @@ namespace Grappa {
       void send_nt_buffer( Core dest, NTBuffer * buf );
       void receive_nt_buffer( RDMABuffer * buf );
 
+      /// Deaggregate the NT buffers other cores of this locale left in our
+      /// rings. Returns true if there were any.
+      bool receive_nt_rings();
+
 
 
 
@@ -301,9 +331,12 @@ namespace Grappa {
       /// Chase a list of messages and serialize them into a buffer.
       /// Modifies pointer to list to support size-limited-ish aggregation
       /// TODO: make this a hard limit?
-      char * aggregate_to_buffer( char * buffer, Grappa::impl::MessageBase ** message_ptr, size_t max = -1, uint64_t * count = NULL );
+      /// All messages go to one core; pass `dictionary` to continue a
+      /// stretch started by an earlier call, or null to start a new one.
+      char * aggregate_to_buffer( char * buffer, Grappa::impl::MessageBase ** message_ptr, size_t max = -1, uint64_t * count = NULL,
+                                  Grappa::impl::HandlerDictionary * dictionary = nullptr );
       
-      // Deserialize and call a buffer of messages
+      // Deserialize and call a buffer of messages for one core
       static char * deaggregate_buffer( char * buffer, size_t size );
 
       /// Grab a list of messages to send
@@ -408,8 +441,10 @@ namespace Grappa {
 
         // have we timed out?
         Grappa::Timestamp current_ts = Grappa::timestamp();
-        if( current_ts - localeCoreData(c)->last_sent_ > FLAGS_aggregator_autoflush_ticks ) {
-          return true;
+        if( current_ts - localeCoreData(c)->last_sent_ > flush_timeout( locale ) ) {
+          // with the adaptive policy, an idle locale's timeout is left
+          // expired so its next message goes out right away
+          return !FLAGS_aggregator_adaptive_flush || check_for_any_work_on( locale );
         }
 
         // // have we reached a size limit?
@@ -439,6 +474,57 @@ namespace Grappa {
       /// ensures we always have some sending resource available.
       void idle_flusher();
 
+      ///
+      /// Adaptive flush policy (-aggregator_adaptive_flush)
+      ///
+      /// The source core for each locale tracks the rate at which bytes
+      /// for it arrive, and every core tracks the round-trip latency of
+      /// its delegates. Messages may wait in the aggregator for a quarter
+      /// of that latency: a round trip waits twice, once for the request
+      /// and once for the reply, so the wait settles at half the network
+      /// latency. If the traffic for a locale fills more
+      /// than -aggregator_target_size bytes in that time, it is flushed
+      /// at the budget or when that many bytes are queued, whichever
+      /// comes first; sparser traffic would wait without filling a
+      /// buffer, so it is flushed sooner, down to
+      /// -aggregator_min_flush_ticks.
+      ///
+
+      struct FlushRate {
+        double bytes_per_tick;
+        Grappa::Timestamp last_send;
+      };
+
+      /// arrival rate per locale; only used for locales this core sends to
+      FlushRate * flush_rates_;
+
+      /// recent delegate round-trip latency in ticks, 0 until measured
+      double round_trip_ticks_;
+
+      inline Grappa::Timestamp flush_timeout( Locale locale ) const {
+        if( !FLAGS_aggregator_adaptive_flush ) return FLAGS_aggregator_autoflush_ticks;
+        return localeCoreData( locale * Grappa::locale_cores() )->flush_ticks_;
+      }
+
+      /// Feed a delegate's round-trip latency to the policy.
+      inline void record_round_trip( int64_t ticks ) {
+        round_trip_ticks_ = round_trip_ticks_ == 0 ? ticks : 0.75 * round_trip_ticks_ + 0.25 * ticks;
+      }
+
+      /// Called by the source core for `locale` after each send to it.
+      void update_flush_policy( Locale locale, int64_t bytes_sent );
+
+      /// Get the sender for `locale` going without waiting for its timeout.
+      void wake_sender( Locale locale ) {
+        if( source_core_for_locale_[ locale ] == Grappa::mycore() ) {
+          Grappa::signal( &(localeCoreData( locale * Grappa::locale_cores() )->send_cv_) );
+        } else {
+          // not on our core, so we can't signal it. instead, cause
+          // polling thread to detect timeout.
+          localeCoreData( locale * Grappa::locale_cores() )->last_sent_ = 0;
+        }
+      }
+
       /// Task that is constantly waiting to receive and
       /// deaggregate. This ensures we always have receiving resource
       /// available.
@@ -476,6 +562,9 @@ namespace Grappa {
         , core_partner_locales_( NULL )
         , core_partner_locale_count_( 0 )
         , ntbuffers_( nullptr )
+        , nt_rings_( nullptr )
+        , flush_rates_( nullptr )
+        , round_trip_ticks_( 0 )
         , flushing_( false )
         , received_buffer_list_()
         , free_buffer_list_()
@@ -550,6 +639,8 @@ namespace Grappa {
             //rdma_local_delivery_time += (double) elapsed / tick_rate;
           }
         }
+        if( nt_rings_ && receive_nt_rings() ) useful = true;
+
         if( useful ) rdma_poll_receive_success++;
         return useful;
       }
@@ -646,6 +737,9 @@ namespace Grappa {
 
         bool spawn_send = false;
 
+        // once the message is in the list another core may send and free it
+        bool urgent = m->is_urgent_;
+
         // prepare to stitch in message
         set_pointer( &new_ml, m );
 
@@ -681,6 +775,19 @@ namespace Grappa {
         dest->prefetch_queue_[ count % prefetch_dist ].size_ = size < max_size_ ? size : max_size_-1;
         set_pointer( &(dest->prefetch_queue_[ count % prefetch_dist ]), m );
 
+        // under the adaptive policy, send early to other locales if
+        // someone is waiting on this message or the flush size is reached
+        Locale dest_locale = Grappa::locale_of( core );
+        if( FLAGS_aggregator_adaptive_flush && !locale_enqueue && dest_locale != Grappa::mylocale() ) {
+          if( urgent ) {
+            rdma_urgent_flushes++;
+            wake_sender( dest_locale );
+          } else if( size >= locale_core->flush_bytes_ ) {
+            rdma_capacity_flushes++;
+            wake_sender( dest_locale );
+          }
+        }
+
 //         // possibly flush if we've passed target size
 //         if( FLAGS_target_size > 0 &&
 //             size > FLAGS_target_size &&
@@ -738,7 +845,7 @@ namespace Grappa {
           DVLOG(5) << __func__ << ": Serializing message from " << tmp;
           char * end = aggregate_to_buffer( buf, &tmp, remaining );
           DVLOG(5) << __func__ << ": After serializing, pointer was " << tmp;
-          DCHECK_EQ( end - buf, size ) << __func__ << ": Whoops! Aggregated message was too long to send as immediate";
+          DCHECK_LE( end - buf, size ) << __func__ << ": Whoops! Aggregated message was too long to send as immediate";
           
           DVLOG(5) << __func__ << ": Sending " << end - buf
                    << " bytes of aggregated messages to " << dest;
@@ -788,7 +895,7 @@ namespace Grappa {
           DVLOG(5) << __func__ << ": Serializing message from " << tmp;
           char * end = aggregate_to_buffer( buf, &tmp, remaining );
           DVLOG(5) << __func__ << ": After serializing, pointer was " << tmp;
-          DCHECK_EQ( end - buf, size ) << __func__ << ": Whoops! Aggregated message was too long to send as immediate";
+          DCHECK_LE( end - buf, size ) << __func__ << ": Whoops! Aggregated message was too long to send as immediate";
           
           DVLOG(5) << __func__ << ": Sending " << end - buf
                    << " bytes of aggregated messages to " << dest;
@@ -801,14 +908,7 @@ namespace Grappa {
       /// Flush one destination.
       void flush( Core c ) {
         rdma_requested_flushes++;
-        Locale locale = Grappa::locale_of(c);
-        if( source_core_for_locale_[ locale ] == Grappa::mycore() ) {
-          Grappa::signal( &(localeCoreData( locale * Grappa::locale_cores() )->send_cv_) );
-        } else {
-          // not on our core, so we can't signal it. instead, cause
-          // polling thread to detect timeout.
-          localeCoreData( locale * Grappa::locale_cores() )->last_sent_ = 0;
-        }
+        wake_sender( Grappa::locale_of(c) );
       }
 
       /// Initiate an idle flush.
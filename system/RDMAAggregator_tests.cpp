@@ -60,14 +60,22 @@ DEFINE_bool( aggregate_dest_multiple, false, "Aggregate to multiple destination
 
 DEFINE_int64( sender_override, 0, "Override core_partner_locale_count_-based decision about number of senders in remote distribution test; if set, use this many" );
 
-DEFINE_string( mode, "serialization", "Which test to run: local, serialization, aggregation, distribution");
+DEFINE_string( mode, "serialization", "Which test to run: local, serialization, aggregation, distribution, flush_policy, header_compaction");
 
 DEFINE_int64( seed, -1, "RNG seed for serialization test" );
 DEFINE_bool( permute, true, "Permute messages in serialization test" );
 DEFINE_int64( prefetch_distance, 4, "Prefetch distance for serialization test" );
 DEFINE_bool( prefetch_enable, false, "Prefetch for serialization test" );
 
+DEFINE_int64( flush_policy_round_trips, 1 << 12, "Blocking delegates timed by the flush policy test" );
+DEFINE_int64( flush_policy_messages, 1 << 16, "Messages sent per core by the flush policy test" );
+DEFINE_int64( header_compaction_messages, 1 << 14, "Messages serialized by the header compaction test" );
+
 DECLARE_int64( rdma_buffers_per_core );
+DECLARE_bool( aggregator_adaptive_flush );
+DECLARE_bool( compact_message_headers );
+
+GRAPPA_DECLARE_METRIC( SummarizingMetric<int64_t>, app_bytes_serialized );
 
 DECLARE_int64( loop_threshold );
 
@@ -103,6 +111,14 @@ GRAPPA_DEFINE_METRIC( SimpleMetric<int64_t>, aggregated_messages_per_locale, 0 )
 GRAPPA_DEFINE_METRIC( SimpleMetric<double>, aggregated_messages_time, 0.0 );
 GRAPPA_DEFINE_METRIC( SimpleMetric<double>, aggregated_messages_rate_per_locale, 0.0 );
 
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, fixed_flush_round_trip_time, 0.0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, fixed_flush_message_rate_per_core, 0.0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, adaptive_flush_round_trip_time, 0.0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, adaptive_flush_message_rate_per_core, 0.0 );
+
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, legacy_header_bytes_per_message, 0.0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, compact_header_bytes_per_message, 0.0 );
+
 
 
 BOOST_AUTO_TEST_CASE( test1 ) {
@@ -442,6 +458,7 @@ BOOST_AUTO_TEST_CASE( test1 ) {
         const size_t sizeof_messages = first->serialized_size() * num_messages;
       
         std::unique_ptr< char[] > buf( new char[ sizeof_messages ] );
+        size_t serialized_bytes = 0;
       
 
         {
@@ -451,7 +468,8 @@ BOOST_AUTO_TEST_CASE( test1 ) {
           {
             // serialize
             uint64_t count = 0;
-            Grappa::impl::global_rdma_aggregator.aggregate_to_buffer( &buf[0], &first, sizeof_messages, &count);
+            char * end = Grappa::impl::global_rdma_aggregator.aggregate_to_buffer( &buf[0], &first, sizeof_messages, &count);
+            serialized_bytes = end - &buf[0];
           }
       
           double time = Grappa::walltime() - start;
@@ -467,7 +485,7 @@ BOOST_AUTO_TEST_CASE( test1 ) {
 
           {
             // deserialize
-            Grappa::impl::global_rdma_aggregator.deaggregate_buffer( &buf[0], sizeof_messages );
+            Grappa::impl::global_rdma_aggregator.deaggregate_buffer( &buf[0], serialized_bytes );
           }
       
           double time = Grappa::walltime() - start;
@@ -793,6 +811,108 @@ BOOST_AUTO_TEST_CASE( test1 ) {
       remote_distributed_messages_rate_per_locale = expected_messages_per_locale / time;
     }
 
+    // compare the fixed and adaptive flush policies: latency of blocking
+    // delegates, then throughput of a stream of small messages. Only
+    // traffic between locales is aggregated, so run with several nodes.
+    if( FLAGS_mode.compare("flush_policy") == 0 ) {
+      LOG(INFO) << "Testing flush policies";
+      if( Grappa::locales() < 2 ) LOG(WARNING) << "One locale: both policies send through shared memory";
+
+      const Core far = Grappa::cores() - 1;
+      for( bool adaptive : { false, true } ) {
+        Grappa::on_all_cores( [adaptive] { FLAGS_aggregator_adaptive_flush = adaptive; } );
+
+        double start = Grappa::walltime();
+        for( int64_t i = 0; i < FLAGS_flush_policy_round_trips; ++i ) {
+          Grappa::delegate::call( far, [] { return 1; } );
+        }
+        double round_trip = (Grappa::walltime() - start) / FLAGS_flush_policy_round_trips;
+
+        start = Grappa::walltime();
+        Grappa::on_all_cores( [] {
+            local_ce.enroll( FLAGS_flush_policy_messages );
+            Grappa::barrier();
+            Core next = (Grappa::mycore() + Grappa::locale_cores()) % Grappa::cores();
+            for( int64_t i = 0; i < FLAGS_flush_policy_messages; ++i ) {
+              Grappa::send_heap_message( next, [] { local_ce.complete(); } );
+            }
+            local_ce.wait();
+          } );
+        double rate = FLAGS_flush_policy_messages / (Grappa::walltime() - start);
+
+        LOG(INFO) << (adaptive ? "adaptive" : "fixed") << " flush policy: "
+                  << round_trip * 1e6 << " us per round trip, "
+                  << rate << " messages/s per core";
+        if( adaptive ) {
+          adaptive_flush_round_trip_time = round_trip;
+          adaptive_flush_message_rate_per_core = rate;
+        } else {
+          fixed_flush_round_trip_time = round_trip;
+          fixed_flush_message_rate_per_core = rate;
+        }
+      }
+    }
+
+    // serialize the same mix of delegate-sized requests with 8-byte
+    // headers and with compact ones, and compare app_bytes_serialized.
+    // Everything stays on this core and nothing yields in between, so
+    // switching the encoding locally is safe.
+    if( FLAGS_mode.compare("header_compaction") == 0 ) {
+      LOG(INFO) << "Testing message header compaction";
+
+      struct ReadRequest {
+        GlobalAddress< int64_t > address;
+        uint32_t pts;
+        void operator()() { local_count++; }
+      };
+      struct WriteRequest {
+        GlobalAddress< int64_t > address;
+        int64_t value;
+        uint32_t pts;
+        void operator()() { local_count++; }
+      };
+
+      const size_t n = FLAGS_header_compaction_messages;
+      std::unique_ptr< Grappa::Message< ReadRequest >[] > reads( new Grappa::Message< ReadRequest >[ n ] );
+      std::unique_ptr< Grappa::Message< WriteRequest >[] > writes( new Grappa::Message< WriteRequest >[ n ] );
+      std::unique_ptr< char[] > buf( new char[ n * ( reads[0].serialized_size() + writes[0].serialized_size() ) ] );
+
+      const bool compact_default = FLAGS_compact_message_headers;
+      for( bool compact : { false, true } ) {
+        // interleave the two kinds
+        for( size_t i = 0; i < n; ++i ) {
+          for( Grappa::impl::MessageBase * m : { (Grappa::impl::MessageBase*) &reads[i],
+                                                 (Grappa::impl::MessageBase*) &writes[i] } ) {
+            m->reset();
+            m->source_ = Grappa::mycore();
+            m->destination_ = Grappa::mycore();
+            m->is_enqueued_ = true;
+          }
+          reads[i].next_ = &writes[i];
+          writes[i].next_ = i + 1 < n ? &reads[i+1] : nullptr;
+        }
+
+        FLAGS_compact_message_headers = compact;
+        local_count = 0;
+        int64_t before = app_bytes_serialized.value();
+        Grappa::impl::MessageBase * first = &reads[0];
+        char * end = Grappa::impl::global_rdma_aggregator.aggregate_to_buffer( &buf[0], &first );
+        double bytes_per_message = double( app_bytes_serialized.value() - before ) / ( 2 * n );
+        Grappa::impl::global_rdma_aggregator.deaggregate_buffer( &buf[0], end - &buf[0] );
+        FLAGS_compact_message_headers = compact_default;
+
+        BOOST_CHECK( first == nullptr );
+        BOOST_CHECK_EQUAL( local_count, 2 * n );
+        LOG(INFO) << (compact ? "compact" : "legacy") << " headers: "
+                  << bytes_per_message << " bytes per message";
+        if( compact ) {
+          compact_header_bytes_per_message = bytes_per_message;
+        } else {
+          legacy_header_bytes_per_message = bytes_per_message;
+        }
+      }
+    }
+
 
 
   
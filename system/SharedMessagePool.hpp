@@ -82,6 +82,16 @@ inline Message<T> * send_heap_message(Core dest, T t) {
   return m;
 }
 
+/// Same as send_heap_message, with a priority for the aggregator.
+template< typename T >
+inline Message<T> * send_heap_message(Core dest, T t, MessagePriority p) {
+  auto *m = new (SharedMessagePool::alloc(sizeof(Message<T>))) Message<T>(dest, t);
+  m->delete_after_send();
+  m->set_priority(p);
+  m->enqueue();
+  return m;
+}
+
 /// Message with payload, allocated on heap and immediately enqueued to be sent.
 template< typename T >
 inline PayloadMessage<T> * send_heap_message(Core dest, T t, void * payload, size_t payload_size) {
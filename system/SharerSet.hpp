@@ -0,0 +1,94 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+
+typedef int16_t Core;
+
+namespace Grappa {
+namespace impl {
+
+/// The cores holding a copy of a write-invalidation object.
+///
+/// Up to MAX_POINTERS sharers are kept exactly, as a list of core ids. One
+/// more switches the set to a coarse 64-bit vector in which bit `c % 64`
+/// stands for every core congruent to it, so the set stays the same size
+/// however many cores there are; on up to 64 cores it is still exact. A
+/// coarse set may name cores that never had a copy, which then receive
+/// (harmless) useless invalidations.
+///
+/// Trivially copyable, so it can be shipped in a delegate reply.
+class SharerSet {
+public:
+  static const int MAX_POINTERS = 4;
+
+private:
+  static const uint8_t COARSE = 0xff;
+
+  // Number of entries in ptrs_, or COARSE once they overflowed into bits_.
+  uint8_t n_;
+  union {
+    Core ptrs_[MAX_POINTERS];
+    uint64_t bits_;
+  };
+
+  static uint64_t bit_of(Core c) { return (uint64_t)1 << (c & 63); }
+
+public:
+  SharerSet() : n_(0), bits_(0) {}
+
+  bool empty() const { return n_ == 0; }
+  bool coarse() const { return n_ == COARSE; }
+
+  void add(Core c) {
+    if (coarse()) {
+      bits_ |= bit_of(c);
+      return;
+    }
+    for (int i = 0; i < n_; i++) {
+      if (ptrs_[i] == c) return;
+    }
+    if (n_ < MAX_POINTERS) {
+      ptrs_[n_++] = c;
+      return;
+    }
+    uint64_t bits = bit_of(c);
+    for (int i = 0; i < n_; i++) bits |= bit_of(ptrs_[i]);
+    bits_ = bits;
+    n_ = COARSE;
+  }
+
+  /// Add every core of `other`.
+  void add_all(const SharerSet& other) {
+    if (!other.coarse()) {
+      for (int i = 0; i < other.n_; i++) add(other.ptrs_[i]);
+      return;
+    }
+    if (!coarse()) {
+      uint64_t bits = 0;
+      for (int i = 0; i < n_; i++) bits |= bit_of(ptrs_[i]);
+      bits_ = bits;
+      n_ = COARSE;
+    }
+    bits_ |= other.bits_;
+  }
+
+  void clear() {
+    n_ = 0;
+    bits_ = 0;
+  }
+
+  /// Apply f to every core in [0, ncores) that may hold a copy.
+  template <typename F>
+  void for_each(Core ncores, F f) const {
+    if (!coarse()) {
+      for (int i = 0; i < n_; i++) f(ptrs_[i]);
+      return;
+    }
+    for (Core c = 0; c < ncores; c++) {
+      if (bits_ & bit_of(c)) f(c);
+    }
+  }
+};
+
+}
+}
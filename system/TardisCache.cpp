@@ -1,6 +1,223 @@
 #include "TardisCache.hpp"
+#include "Metrics.hpp"
+#include "CallbackMetric.hpp"
+#include "LocaleSharedMemory.hpp"
+#include <algorithm>
 
 DEFINE_int32(cache_proto, GRAPPA_VANILLA, "CC protocol");
 DEFINE_int32(lease, 200, "The lease of Tardis protocol.");
 DEFINE_int32(max_cache_number, 400000, "Cache size limit.");
+DEFINE_bool(tardis_bg_renewal, false,
+    "Renew Tardis leases of cached objects in the background before they expire.");
+DEFINE_int32(tardis_renewal_margin, 20,
+    "Queue a cached object for background renewal once a hit finds its lease "
+    "this close to expiring.");
+DEFINE_int32(tardis_write_buffer, 0,
+    "Buffer up to this many remote Tardis writes per core, coalescing writes "
+    "to the same address, and publish them in batches (0: write through).");
+DEFINE_int32(tardis_write_buffer_us, 100,
+    "Publish buffered Tardis writes at most this many microseconds after the "
+    "oldest was buffered, even on a core doing no more Tardis operations.");
+DEFINE_int32(tardis_locale_cache, 0,
+    "Share Tardis copies between the cores of a locale in a table of this "
+    "many slots (rounded up to a power of two) in locale shared memory, "
+    "checked when a core's own cache misses (0: private caches only).");
+DEFINE_int32(tardis_hot_sample, 0,
+    "Sample one in this many remote Tardis reads at the owner to find hot "
+    "objects, and push new versions of those to their readers (0: off).");
+DEFINE_int32(tardis_hot_threshold, 16,
+    "Sampled reads within one window that promote an object to hot.");
+DEFINE_int32(tardis_hot_window, 4096,
+    "Sampled reads per hot-key window; a hot object read less than "
+    "tardis_hot_threshold samples' worth in a window is demoted.");
+DEFINE_int32(tardis_hot_lease, 2000,
+    "Lease granted on reads of a hot object.");
+DEFINE_bool(tardis_owner_batch, false,
+    "Queue Tardis refetches at the owner and serve all those that arrive "
+    "together at once, replying with one message per requesting core.");
+DEFINE_string(tardis_renewal, "full",
+    "How a Tardis reader handles an expired copy: full (refetch the object), "
+    "two_stage (renew the lease by timestamp, refetch only if it changed) or "
+    "adaptive (two_stage for objects the owner rarely sees overwritten).");
 
+tardis_renewal_t tardis_renewal_mode() {
+  // Flags may be changed at run time, so re-parse whenever it differs.
+  static std::string parsed;
+  static tardis_renewal_t mode = TARDIS_RENEWAL_FULL;
+  if (FLAGS_tardis_renewal != parsed) {
+    if (FLAGS_tardis_renewal == "full") mode = TARDIS_RENEWAL_FULL;
+    else if (FLAGS_tardis_renewal == "two_stage") mode = TARDIS_RENEWAL_TWO_STAGE;
+    else if (FLAGS_tardis_renewal == "adaptive") mode = TARDIS_RENEWAL_ADAPTIVE;
+    else LOG(FATAL) << "Unknown -tardis_renewal=" << FLAGS_tardis_renewal
+      << "; expected full, two_stage or adaptive";
+    parsed = FLAGS_tardis_renewal;
+  }
+  return mode;
+}
+
+DEFINE_string(tardis_lease_policy, "linear",
+    "How a Tardis owner sizes leases: linear (one longer per read, reset by a "
+    "write), exponential (doubled per read, halved by a write) or ratio (the "
+    "average number of reads between writes of the object).");
+
+namespace Grappa {
+namespace impl {
+
+static void linear_grant(tardis_owner_cache_info& o) {
+  o.lease = std::min<int>(o.lease + 1, FLAGS_lease);
+}
+static void linear_revoke(tardis_owner_cache_info& o) {
+  o.lease = 1;
+}
+
+static void exponential_grant(tardis_owner_cache_info& o) {
+  o.lease = std::min<int>(o.lease * 2, FLAGS_lease);
+}
+static void exponential_revoke(tardis_owner_cache_info& o) {
+  o.lease = std::max<int>(o.lease / 2, 1);
+}
+
+// Both counts are halved whenever one reaches this, so the ratio follows
+// the last few dozen accesses.
+static const int RATIO_WINDOW = 64;
+
+static void ratio_count(unsigned char& c, unsigned char& other) {
+  if (++c == RATIO_WINDOW) {
+    c /= 2;
+    other /= 2;
+  }
+}
+static void ratio_apply(tardis_owner_cache_info& o) {
+  // What the linear policy would reach by the next write, on average.
+  o.lease = std::min<int>(1 + o.reads / (o.writes + 1), FLAGS_lease);
+}
+static void ratio_grant(tardis_owner_cache_info& o) {
+  ratio_count(o.reads, o.writes);
+  ratio_apply(o);
+}
+static void ratio_revoke(tardis_owner_cache_info& o) {
+  ratio_count(o.writes, o.reads);
+  ratio_apply(o);
+}
+
+static const lease_policy lease_policies[] = {
+  { "linear", linear_grant, linear_revoke },
+  { "exponential", exponential_grant, exponential_revoke },
+  { "ratio", ratio_grant, ratio_revoke },
+};
+
+const lease_policy& tardis_lease_policy() {
+  static std::string parsed;
+  static const lease_policy* policy = &lease_policies[0];
+  if (FLAGS_tardis_lease_policy != parsed) {
+    policy = nullptr;
+    for (auto& p : lease_policies) {
+      if (FLAGS_tardis_lease_policy == p.name) policy = &p;
+    }
+    if (policy == nullptr) {
+      LOG(FATAL) << "Unknown -tardis_lease_policy=" << FLAGS_tardis_lease_policy
+        << "; expected linear, exponential or ratio";
+    }
+    parsed = FLAGS_tardis_lease_policy;
+  }
+  return *policy;
+}
+
+}
+}
+
+namespace GlobalCacheData {
+  Grappa::impl::OwnerTable<tardis_o_t> tardis_owner_cache;
+  Grappa::impl::OwnerTable<wi_o_t> wi_owner_cache;
+  Grappa::impl::CacheTable<tardis_c_t> tardis_cache;
+  Grappa::impl::CacheTable<wi_c_t> wi_cache;
+  Grappa::impl::CacheArena payload_arena;
+  std::unordered_map<uintptr_t, Grappa::impl::tardis_hot_key> tardis_hot_keys;
+  std::unordered_map<uintptr_t, std::vector<uintptr_t>> wi_block_keys;
+  Grappa::impl::LocaleCache locale_cache;
+
+  Grappa::impl::LocaleCache& shared_locale_cache() {
+    CHECK_GT(FLAGS_tardis_locale_cache, 0);
+    if (!locale_cache.initialized()) {
+      size_t n = 1;
+      while (n < (size_t)FLAGS_tardis_locale_cache) n <<= 1;
+      // Whichever core of the locale gets here first creates the slots.
+      auto& segment = Grappa::impl::locale_shared_memory.segment;
+      auto* slots = segment.find_or_construct<Grappa::impl::LocaleCache::slot_t>(
+          "TardisLocaleCache")[n]();
+      locale_cache.attach(slots, n);
+    }
+    return locale_cache;
+  }
+};
+
+GRAPPA_DEFINE_METRIC(CallbackMetric<uint64_t>, cache_arena_reserved_bytes, []{
+  return (uint64_t)GlobalCacheData::payload_arena.reserved_bytes();
+});
+GRAPPA_DEFINE_METRIC(CallbackMetric<uint64_t>, cache_arena_live_bytes, []{
+  return (uint64_t)GlobalCacheData::payload_arena.live_bytes();
+});
+GRAPPA_DEFINE_METRIC(CallbackMetric<uint64_t>, cache_arena_live_objects, []{
+  return (uint64_t)GlobalCacheData::payload_arena.live_objects();
+});
+GRAPPA_DEFINE_METRIC(CallbackMetric<double>, cache_arena_fragmentation, []{
+  return GlobalCacheData::payload_arena.fragmentation();
+});
+
+// Objects owned here that are currently promoted to hot.
+GRAPPA_DEFINE_METRIC(CallbackMetric<uint64_t>, tardis_hot_key_count, []{
+  return (uint64_t)GlobalCacheData::tardis_hot_keys.size();
+});
+
+// Size of the locale tier, and how many of its slots hold a copy. Every
+// core of a locale sees the same table, so only its first core reports it
+// and the totals over all cores count each locale once.
+GRAPPA_DEFINE_METRIC(CallbackMetric<uint64_t>, tardis_locale_cache_bytes, []{
+  if (Grappa::locale_mycore() != 0) return (uint64_t)0;
+  return (uint64_t)GlobalCacheData::locale_cache.bytes();
+});
+GRAPPA_DEFINE_METRIC(CallbackMetric<uint64_t>, tardis_locale_cache_entries, []{
+  if (Grappa::locale_mycore() != 0) return (uint64_t)0;
+  return (uint64_t)GlobalCacheData::locale_cache.size();
+});
+
+struct cache_table_stats {
+  uint64_t evictions, scans, max_scan;
+};
+
+template <typename E>
+static cache_table_stats stats_of(const Grappa::impl::CacheTable<E>& c) {
+  return cache_table_stats{ c.evictions(), c.eviction_scans(), c.max_eviction_scan() };
+}
+
+static cache_table_stats current_table_stats() {
+  if (FLAGS_cache_proto == GRAPPA_TARDIS) return stats_of(GlobalCacheData::tardis_cache);
+  if (FLAGS_cache_proto == GRAPPA_WI) return stats_of(GlobalCacheData::wi_cache);
+  return cache_table_stats{ 0, 0, 0 };
+}
+
+GRAPPA_DEFINE_METRIC(CallbackMetric<uint64_t>, cache_evictions, []{
+  return current_table_stats().evictions;
+});
+// Ring entries examined per eviction; stays near 1 regardless of how many
+// entries are pinned.
+GRAPPA_DEFINE_METRIC(CallbackMetric<double>, cache_eviction_scan_avg, []{
+  auto s = current_table_stats();
+  return s.evictions == 0 ? 0.0 : (double)s.scans / s.evictions;
+});
+GRAPPA_DEFINE_METRIC(CallbackMetric<uint64_t>, cache_eviction_scan_max, []{
+  return current_table_stats().max_scan;
+});
+
+// Owned objects with coherence metadata, and how many of them did not get
+// a slot of the owner table and live in its fallback map.
+GRAPPA_DEFINE_METRIC(CallbackMetric<uint64_t>, owner_table_entries, []{
+  if (FLAGS_cache_proto == GRAPPA_TARDIS) return (uint64_t)GlobalCacheData::tardis_owner_cache.size();
+  if (FLAGS_cache_proto == GRAPPA_WI) return (uint64_t)GlobalCacheData::wi_owner_cache.size();
+  return (uint64_t)0;
+});
+GRAPPA_DEFINE_METRIC(CallbackMetric<uint64_t>, owner_table_overflow, []{
+  if (FLAGS_cache_proto == GRAPPA_TARDIS) return (uint64_t)GlobalCacheData::tardis_owner_cache.overflow();
+  if (FLAGS_cache_proto == GRAPPA_WI) return (uint64_t)GlobalCacheData::wi_owner_cache.overflow();
+  return (uint64_t)0;
+});
@@ -1,39 +1,69 @@
 #pragma once
-#include <bitset>
-#include <list>
 #include <unordered_map>
+#include <vector>
 #include <gflags/gflags.h>
 #include <string.h>
+#include "CacheTable.hpp"
+#include "CacheArena.hpp"
+#include "SharerSet.hpp"
+#include "OwnerTable.hpp"
+#include "LocaleCache.hpp"
 
-//#define TARDIS_TWO_STAGE_RENEWAL
-//#ifdef TARDIS_BG_RENEWAL
 // Cache protocol. Only one of them can be defined
 enum cache_proto_t { GRAPPA_VANILLA = 0, GRAPPA_TARDIS, GRAPPA_WI };
 static const char* cache_proto_str[] =  { "Vanilla", "Tardis", "Write-Invalidation" };
+// What a Tardis reader does with an expired copy (-tardis_renewal):
+// refetch it, first try to renew its lease with a timestamp-only request,
+// or choose per object from how often the owner sees it overwritten.
+enum tardis_renewal_t { TARDIS_RENEWAL_FULL = 0, TARDIS_RENEWAL_TWO_STAGE,
+  TARDIS_RENEWAL_ADAPTIVE };
 // The definiations are given in TardisCache.cpp
 DECLARE_int32(cache_proto);
 DECLARE_int32(max_cache_number);
 DECLARE_int32(lease);
-static const int MAX_NODE_NUMBER = 160;
+DECLARE_bool(tardis_bg_renewal);
+DECLARE_int32(tardis_renewal_margin);
+DECLARE_string(tardis_renewal);
+DECLARE_string(tardis_lease_policy);
+DECLARE_int32(tardis_write_buffer);
+DECLARE_int32(tardis_write_buffer_us);
+DECLARE_int32(tardis_locale_cache);
+DECLARE_int32(tardis_hot_sample);
+DECLARE_int32(tardis_hot_threshold);
+DECLARE_int32(tardis_hot_window);
+DECLARE_int32(tardis_hot_lease);
+DECLARE_bool(tardis_owner_batch);
 
-typedef uint32_t timestamp_t;
+// Logical time of the Tardis protocol. Clocks only move forward, by up to a
+// lease per operation (apps also jump a lease per iteration), so 32 bits
+// wrap within hours on a busy core, and a wrapped pts makes every expired
+// copy look fresh again. 64 bits never wrap in practice.
+typedef uint64_t timestamp_t;
+
+/// Parsed value of -tardis_renewal.
+tardis_renewal_t tardis_renewal_mode();
 
 namespace Grappa {
+class Worker;
+
 namespace impl {
 
 struct cache_info_base {
-  cache_info_base() : refcnt(0), usedcnt(0), size(0), object(nullptr) {}
-  cache_info_base(void* obj, size_t sz) : object(obj), size(sz),
-    refcnt(0), usedcnt(0) {}
+  cache_info_base() : refcnt(0), usedcnt(0), size(0), referenced(false),
+    object(nullptr), key(0) {}
+  cache_info_base(void* obj, size_t sz) : refcnt(0), usedcnt(0), size(sz),
+    referenced(false), object(obj), key(0) {}
   // How many actived tasks (might access internal data of cache_info) are there?
-  mutable char refcnt;
+  mutable uint16_t refcnt;
   // How many tasks who holds the reference to cache_info are there?
-  mutable char usedcnt;
+  mutable uint16_t usedcnt;
   // These two fields implements template parameters.
   mutable uint16_t size;
+  // CLOCK reference bit, maintained by CacheTable.
+  mutable bool referenced;
   mutable void* object;
-  // O(1) remove/insertion time for LRU list.
-  mutable std::list<uintptr_t>::iterator lru_iter;
+  // Raw bits of the cached GlobalAddress (plus BLOCK_KEY_BIT for blocks).
+  uintptr_t key;
 
   void assign(const void* obj) {
     // This object has been freed.
@@ -43,36 +73,106 @@ struct cache_info_base {
   void* get_object() { return object; }
 };
 
+// The counts take the padding before `object`; entries stay at 24 bytes.
+static_assert(sizeof(cache_info_base) == 24,
+    "cache entries should stay packed");
+
 template <typename T>
 struct lock_obj { T object; bool locked; };
 
+/// One whole global block, the unit in which delegate::read_range caches
+/// objects too large for a single block.
+struct cache_block { char data[64]; };
+
+/// Set in the cache key of a cache_block, so a cached block and an object
+/// starting at the same address are separate entries. No GlobalAddress has
+/// this bit set: it lies above any heap offset and any core number.
+static const uintptr_t BLOCK_KEY_BIT = (uintptr_t)1 << 62;
+
 struct tardis_owner_cache_info {
-  tardis_owner_cache_info() : rts(0), wts(0), lease(1) {}
+  tardis_owner_cache_info() : rts(0), wts(0), lease(1), write_heat(0),
+    reads(0), writes(0), heat(0), heat_window(0), hot(false) {}
   timestamp_t rts, wts;
   unsigned char lease;
+  // Saturating 2-bit count of expired copies that turned out to be
+  // overwritten when their reader came back to renew or refetch them.
+  unsigned char write_heat;
+
+  void observe_expired(bool overwritten) {
+    if (overwritten) {
+      if (write_heat < 3) write_heat++;
+    } else if (write_heat > 0) {
+      write_heat--;
+    }
+  }
+  // Whether a timestamp-only renewal is likely to succeed.
+  bool renewable() const { return write_heat < 2; }
+
+  // Decaying read and write counts, kept by the "ratio" lease policy.
+  unsigned char reads, writes;
+
+  // Sampled remote reads in hot-key window `heat_window` (mod 256), and
+  // whether the object is promoted (-tardis_hot_sample).
+  unsigned char heat, heat_window;
+  bool hot;
+};
+
+// One OwnerTable slot (key plus this) stays at 32 bytes.
+static_assert(sizeof(tardis_owner_cache_info) <= 24,
+    "Tardis owner metadata should stay packed");
+
+/// A block its owner has promoted to replicated mode: the cores that have
+/// read objects in it since, which are pushed every new version, and its
+/// reads in the current window.
+struct tardis_hot_key {
+  tardis_owner_cache_info* owner;
+  SharerSet readers;
+  uint32_t reads;
 };
 
+/// How an owner sizes the lease it hands out with an object. `grant` runs
+/// on every remote read or renewal, before the lease is applied, and
+/// `revoke` on every write. Chosen per run with -tardis_lease_policy.
+struct lease_policy {
+  const char* name;
+  void (*grant)(tardis_owner_cache_info&);
+  void (*revoke)(tardis_owner_cache_info&);
+};
+
+/// The policy named by -tardis_lease_policy.
+const lease_policy& tardis_lease_policy();
+
 struct tardis_cache_info : cache_info_base {
-  tardis_cache_info() : cache_info_base() {}
+  tardis_cache_info() : cache_info_base(), rts(0), wts(0), renewing(false),
+    renew_first(true) {}
   tardis_cache_info(void *obj, size_t sz) : cache_info_base(obj, sz),
-    rts(0), wts(0) {}
+    rts(0), wts(0), renewing(false), renew_first(true) {}
   mutable timestamp_t rts, wts;
+  // Queued for background lease renewal.
+  mutable bool renewing;
+  // Owner's hint for -tardis_renewal=adaptive, from the last fetch.
+  mutable bool renew_first;
 };
 
 template< typename T >
 struct rpc_read_result {
   rpc_read_result(T _r, const tardis_owner_cache_info& c) : r(_r), rts(c.rts),
-    wts(c.wts) {}
+    wts(c.wts), renewable(c.renewable()) {}
   rpc_read_result() {}
   timestamp_t rts, wts;
+  bool renewable;
   T r;
 };
 
 struct wi_owner_cache_info {
-  std::bitset<MAX_NODE_NUMBER> copyset;
+  SharerSet copyset;
   // Whether this object is locked globally.
   bool locked;
-  wi_owner_cache_info(): locked(false) {}
+  // Requests parked until the object is unlocked, oldest first (linked
+  // through Worker::next).
+  Worker* wait_head;
+  Worker* wait_tail;
+  wi_owner_cache_info(): locked(false), wait_head(nullptr), wait_tail(nullptr) {}
 };
 
 struct wi_cache_info : cache_info_base {
@@ -90,10 +190,23 @@ using tardis_c_t = Grappa::impl::tardis_cache_info;
 using wi_c_t = Grappa::impl::wi_cache_info;
 
 /// C++ template is hard to use!!!
+/// One copy per core; the definitions are given in TardisCache.cpp.
 namespace GlobalCacheData {
-  static std::unordered_map<uintptr_t, tardis_o_t> tardis_owner_cache;
-  static std::unordered_map<uintptr_t, wi_o_t> wi_owner_cache;
-  static std::unordered_map<uintptr_t, tardis_c_t> tardis_cache;
-  static std::unordered_map<uintptr_t, wi_c_t> wi_cache;
-  static std::list<uintptr_t> lru;
+  extern Grappa::impl::OwnerTable<tardis_o_t> tardis_owner_cache;
+  extern Grappa::impl::OwnerTable<wi_o_t> wi_owner_cache;
+  extern Grappa::impl::CacheTable<tardis_c_t> tardis_cache;
+  extern Grappa::impl::CacheTable<wi_c_t> wi_cache;
+  // Backing store for the payloads of whichever cache is in use.
+  extern Grappa::impl::CacheArena payload_arena;
+  // Blocks owned here that are promoted to replicated mode, by block base.
+  extern std::unordered_map<uintptr_t, Grappa::impl::tardis_hot_key> tardis_hot_keys;
+  // Keys of the WI copies cached here that overlap each block, by block.
+  extern std::unordered_map<uintptr_t, std::vector<uintptr_t>> wi_block_keys;
+  // This core's handle on the Tardis copies shared by its locale; use
+  // shared_locale_cache().
+  extern Grappa::impl::LocaleCache locale_cache;
+
+  /// The locale's shared Tardis cache, set up in locale shared memory on
+  /// first use; only call with -tardis_locale_cache > 0.
+  Grappa::impl::LocaleCache& shared_locale_cache();
 };
@@ -0,0 +1,233 @@
+////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010-2015, University of Washington and Battelle
+// Memorial Institute.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//     * Redistributions of source code must retain the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer.
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials
+//       provided with the distribution.
+//     * Neither the name of the University of Washington, Battelle
+//       Memorial Institute, or the names of their contributors may be
+//       used to endorse or promote products derived from this
+//       software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// UNIVERSITY OF WASHINGTON OR BATTELLE MEMORIAL INSTITUTE BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+////////////////////////////////////////////////////////////////////////
+/// Microbenchmark for the coherence cache lookup path.
+///
+/// Compares CacheTable (open addressing + CLOCK) against the previous
+/// std::unordered_map + std::list LRU that find_tardis_cache used, replayed
+/// here verbatim so the two can be measured side by side on one core.
+///
+/// Example (YCSB-like: 192-byte records, 25k cache entries):
+///   grappa_run -n1 -p1 -- TardisCache_bench.exe --max_cache_number=25000
+
+#include "Grappa.hpp"
+#include "Metrics.hpp"
+
+#include <list>
+#include <unordered_map>
+#include <cmath>
+
+DEFINE_uint64( bench_keys, 100000, "Number of distinct cached addresses" );
+DEFINE_uint64( bench_ops, 10000000, "Lookups per implementation" );
+DEFINE_uint64( bench_object_size, 192, "Payload size (and key stride) in bytes" );
+DEFINE_double( bench_alpha, 0.99, "Zipf skew of the key stream (0 = uniform)" );
+DEFINE_bool( bench_mixed_sizes, true, "Vary payload size per key up to bench_object_size" );
+DEFINE_uint64( bench_pinned, 0, "Keep the first N cached entries pinned, as in-flight tasks would" );
+
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, tardis_cache_bench_table_ns, 0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, tardis_cache_bench_table_hit_rate, 0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, tardis_cache_bench_arena_ns, 0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, tardis_cache_bench_arena_fragmentation, 0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, tardis_cache_bench_eviction_scan_avg, 0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, tardis_cache_bench_legacy_ns, 0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, tardis_cache_bench_legacy_hit_rate, 0 );
+
+using namespace Grappa;
+
+/// The lookup path find_tardis_cache used before CacheTable.
+struct LegacyCache {
+  struct info : tardis_c_t {
+    info() : tardis_c_t() {}
+    info(void* obj, size_t sz) : tardis_c_t(obj, sz) {}
+    std::list<uintptr_t>::iterator lru_iter;
+  };
+  std::unordered_map<uintptr_t, info> cache;
+  std::list<uintptr_t> lru;
+  size_t capacity;
+
+  info& find(uintptr_t key, size_t size, bool* valid) {
+    auto it = cache.find(key);
+    void *freed_space = nullptr;
+    if (it == cache.end()) {
+      *valid = false;
+      while (lru.size() >= capacity) {
+        auto victim = lru.rbegin();
+        while (victim != lru.rend() && cache[*victim].usedcnt > 0)
+          victim++;
+        if (victim != lru.rend()) {
+          auto v = cache.find(*victim);
+          if (v->second.size == size) {
+            if (freed_space != nullptr) free(freed_space);
+            freed_space = v->second.object;
+          } else {
+            free(v->second.object);
+          }
+          lru.erase(v->second.lru_iter);
+          cache.erase(v);
+        }
+      }
+      if (freed_space == nullptr) freed_space = malloc(size);
+      lru.push_front(key);
+      auto& r = cache[key] = info(freed_space, size);
+      r.lru_iter = lru.begin();
+      return r;
+    }
+    *valid = true;
+    lru.erase(it->second.lru_iter);
+    lru.push_front(key);
+    it->second.lru_iter = lru.begin();
+    return it->second;
+  }
+};
+
+/// Sample key indices from a Zipf distribution by inverting the CDF.
+std::vector<uint32_t> make_stream() {
+  std::vector<double> cdf(FLAGS_bench_keys);
+  double sum = 0;
+  for (uint64_t i = 0; i < FLAGS_bench_keys; i++) {
+    sum += pow(i + 1, -FLAGS_bench_alpha);
+    cdf[i] = sum;
+  }
+  // Scatter popular keys so they do not sit next to each other.
+  std::vector<uint32_t> perm(FLAGS_bench_keys);
+  for (uint64_t i = 0; i < FLAGS_bench_keys; i++) perm[i] = i;
+  std::random_shuffle(perm.begin(), perm.end());
+
+  std::vector<uint32_t> stream(FLAGS_bench_ops);
+  for (auto& s : stream) {
+    double dice = sum * rand() / RAND_MAX;
+    size_t idx = std::lower_bound(cdf.begin(), cdf.end(), dice) - cdf.begin();
+    s = perm[std::min<size_t>(idx, FLAGS_bench_keys - 1)];
+  }
+  return stream;
+}
+
+int main(int argc, char* argv[]) {
+  Grappa::init(&argc, &argv);
+  Grappa::run([]{
+    srand(0);
+    auto stream = make_stream();
+    size_t sz = FLAGS_bench_object_size;
+    CHECK_LT(FLAGS_bench_pinned, FLAGS_max_cache_number) << "nothing left to evict";
+    auto object_size = [=](uint32_t k) -> size_t {
+      return FLAGS_bench_mixed_sizes ? 8 + (k * 2654435761u) % (sz - 7) : sz;
+    };
+
+    // Same lookup loop as Addressing::find_cache, with payloads coming
+    // either from malloc or from a CacheArena.
+    auto run_table = [&](impl::CacheArena* arena) {
+      impl::CacheTable<tardis_c_t> table;
+      table.init(FLAGS_max_cache_number);
+      if (arena) arena->init(FLAGS_max_cache_number);
+      uint64_t hits = 0;
+      uint64_t pinned = 0;
+      double start = walltime();
+      for (auto k : stream) {
+        uintptr_t key = (uintptr_t)k * sz;
+        auto* e = table.find(key);
+        if (e != nullptr) {
+          hits++;
+          continue;
+        }
+        size_t want = object_size(k);
+        void* old_object;
+        size_t old_size;
+        auto& r = table.claim(key, &old_object, &old_size);
+        if (arena) {
+          if (old_object != nullptr) {
+            if (impl::CacheArena::same_class(old_size, want)) {
+              arena->resize(old_size, want);
+            } else {
+              arena->deallocate(old_object, old_size);
+              old_object = nullptr;
+            }
+          }
+          r.object = old_object ? old_object : arena->allocate(want);
+        } else {
+          if (old_object != nullptr && old_size != want) { free(old_object); old_object = nullptr; }
+          r.object = old_object ? old_object : malloc(want);
+        }
+        r.size = want;
+        if (pinned < FLAGS_bench_pinned) { table.pin(r); pinned++; }
+      }
+      double ns = (walltime() - start) * 1e9 / stream.size();
+      if (table.evictions() > 0) {
+        tardis_cache_bench_eviction_scan_avg = (double)table.eviction_scans() / table.evictions();
+      }
+      if (arena) {
+        tardis_cache_bench_arena_fragmentation = arena->fragmentation();
+        table.for_each([=](tardis_c_t& e) { arena->deallocate(e.object, e.size); });
+      } else {
+        tardis_cache_bench_table_hit_rate = (double)hits / stream.size();
+        table.for_each([](tardis_c_t& e) { free(e.object); });
+      }
+      return ns;
+    };
+
+    tardis_cache_bench_table_ns = run_table(nullptr);
+    {
+      impl::CacheArena arena;
+      tardis_cache_bench_arena_ns = run_table(&arena);
+    }
+
+    {
+      LegacyCache legacy;
+      legacy.capacity = FLAGS_max_cache_number;
+      uint64_t hits = 0;
+      uint64_t pinned = 0;
+      double start = walltime();
+      for (auto k : stream) {
+        bool valid;
+        auto& r = legacy.find((uintptr_t)k * sz, object_size(k), &valid);
+        if (valid) {
+          hits++;
+        } else if (pinned < FLAGS_bench_pinned) {
+          r.usedcnt = 1;
+          pinned++;
+        }
+      }
+      tardis_cache_bench_legacy_ns = (walltime() - start) * 1e9 / stream.size();
+      tardis_cache_bench_legacy_hit_rate = (double)hits / stream.size();
+      for (auto& e : legacy.cache) free(e.second.object);
+    }
+
+    LOG(INFO) << "CacheTable: " << tardis_cache_bench_table_ns.value() << " ns/lookup, "
+      << tardis_cache_bench_eviction_scan_avg.value() << " entries scanned per eviction, hit rate "
+      << tardis_cache_bench_table_hit_rate.value();
+    LOG(INFO) << "CacheTable+CacheArena: " << tardis_cache_bench_arena_ns.value()
+      << " ns/lookup, fragmentation " << tardis_cache_bench_arena_fragmentation.value();
+    LOG(INFO) << "unordered_map+list LRU: " << tardis_cache_bench_legacy_ns.value()
+      << " ns/lookup, hit rate " << tardis_cache_bench_legacy_hit_rate.value();
+  });
+  Grappa::finalize();
+}
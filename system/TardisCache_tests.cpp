@@ -0,0 +1,1141 @@
+////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010-2015, University of Washington and Battelle
+// Memorial Institute.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//     * Redistributions of source code must retain the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer.
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials
+//       provided with the distribution.
+//     * Neither the name of the University of Washington, Battelle
+//       Memorial Institute, or the names of their contributors may be
+//       used to endorse or promote products derived from this
+//       software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// UNIVERSITY OF WASHINGTON OR BATTELLE MEMORIAL INSTITUTE BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+////////////////////////////////////////////////////////////////////////
+/// Tests for the coherence cache table and the Tardis read/write path.
+
+#include <boost/test/unit_test.hpp>
+
+#include "Grappa.hpp"
+#include "Delegate.hpp"
+#include "GlobalAllocator.hpp"
+#include "CallbackMetric.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+
+using namespace Grappa;
+
+GRAPPA_DECLARE_METRIC(CallbackMetric<uint64_t>, tardis_locale_cache_entries);
+
+BOOST_AUTO_TEST_SUITE( TardisCache_tests );
+
+void check_table() {
+  impl::CacheTable<tardis_c_t> table;
+  table.init(64);
+  BOOST_CHECK_EQUAL( table.capacity(), 64 );
+
+  void* old_object;
+  size_t old_size;
+  // Fill the table; no eviction yet.
+  for (uintptr_t k = 0; k < 64; k++) {
+    auto& e = table.claim(k * 64, &old_object, &old_size);
+    BOOST_CHECK( old_object == nullptr );
+    e.rts = k;
+  }
+  BOOST_CHECK( table.full() );
+  for (uintptr_t k = 0; k < 64; k++) {
+    auto* e = table.find(k * 64);
+    BOOST_REQUIRE( e != nullptr );
+    BOOST_CHECK_EQUAL( e->rts, k );
+    BOOST_CHECK_EQUAL( e->key, k * 64 );
+  }
+  BOOST_CHECK( table.find(64 * 64) == nullptr );
+
+  // Pin everything except key 7; the victim must be 7.
+  table.for_each([&](tardis_c_t& e) { if (e.key != 7 * 64) table.pin(e); });
+  table.claim(1000 * 64, &old_object, &old_size);
+  BOOST_CHECK( table.find(7 * 64) == nullptr );
+  BOOST_CHECK( table.find(1000 * 64) != nullptr );
+  // Misses never walk past the pinned entries.
+  for (uintptr_t k = 1001; k < 1100; k++) {
+    table.claim(k * 64, &old_object, &old_size);
+    BOOST_CHECK( table.find((k - 1) * 64) == nullptr );
+  }
+  BOOST_CHECK_EQUAL( table.evictions(), 100 );
+  BOOST_CHECK_LE( table.max_eviction_scan(), 2 );
+  table.for_each([&](tardis_c_t& e) { if (e.usedcnt > 0) table.unpin(e); });
+
+  // An entry held by more tasks than a byte can count stays pinned until
+  // the last one lets go.
+  auto* held = table.find(1099 * 64);
+  BOOST_REQUIRE( held != nullptr );
+  for (int i = 0; i < 300; i++) table.pin(*held);
+  for (uintptr_t k = 2000; k < 2200; k++) table.claim(k * 64, &old_object, &old_size);
+  BOOST_CHECK( table.find(1099 * 64) == held );
+  for (int i = 0; i < 300; i++) table.unpin(*held);
+  for (uintptr_t k = 2200; k < 2400; k++) table.claim(k * 64, &old_object, &old_size);
+  BOOST_CHECK( table.find(1099 * 64) == nullptr );
+
+  // Random churn against a reference map.
+  std::unordered_map<uintptr_t,timestamp_t> model;
+  table.clear();
+  BOOST_CHECK_EQUAL( table.size(), 0 );
+  srand(12345);
+  for (int i = 0; i < 20000; i++) {
+    uintptr_t k = (rand() % 256) * 192;
+    auto* e = table.find(k);
+    if (e != nullptr) {
+      BOOST_CHECK_EQUAL( e->rts, model[k] );
+      continue;
+    }
+    auto& n = table.claim(k, &old_object, &old_size);
+    n.rts = i;
+    model[k] = i;
+  }
+  size_t live = 0;
+  table.for_each([&](tardis_c_t& e) {
+    live++;
+    BOOST_CHECK( table.find(e.key) == &e );
+  });
+  BOOST_CHECK_EQUAL( live, 64 );
+}
+
+void check_arena() {
+  impl::CacheArena arena;
+  arena.init(64);
+  BOOST_CHECK( impl::CacheArena::same_class(17, 32) );
+  BOOST_CHECK( !impl::CacheArena::same_class(16, 17) );
+
+  // Objects of one class are carved contiguously from a single slab.
+  std::vector<char*> objs;
+  for (int i = 0; i < 64; i++) {
+    objs.push_back((char*)arena.allocate(24));
+    memset(objs.back(), i, 24);
+  }
+  for (int i = 1; i < 64; i++) {
+    BOOST_CHECK_EQUAL( objs[i] - objs[i-1], 32 );
+  }
+  BOOST_CHECK_EQUAL( arena.live_objects(), 64 );
+  BOOST_CHECK_EQUAL( arena.live_bytes(), 64 * 24 );
+  BOOST_CHECK_EQUAL( arena.reserved_bytes(), 64 * 32 );
+  BOOST_CHECK_CLOSE( arena.fragmentation(), 0.25, 1e-6 );
+  for (int i = 0; i < 64; i++) {
+    BOOST_CHECK_EQUAL( objs[i][23], (char)i );
+  }
+
+  // Freed payloads are handed back before any new slab is taken.
+  arena.deallocate(objs[5], 24);
+  BOOST_CHECK( arena.allocate(30) == objs[5] );
+  BOOST_CHECK_EQUAL( arena.reserved_bytes(), 64 * 32 );
+
+  // clear() recycles the slabs.
+  arena.clear();
+  BOOST_CHECK_EQUAL( arena.live_objects(), 0 );
+  BOOST_CHECK( arena.allocate(32) == objs[0] );
+  BOOST_CHECK_EQUAL( arena.reserved_bytes(), 64 * 32 );
+}
+
+int64_t some_data GRAPPA_BLOCK_ALIGNED = 1234;
+
+void check_tardis() {
+  auto a = make_global(&some_data, 1);
+
+  // Reads from core 0 are served by a cached copy until its lease expires.
+  BOOST_CHECK_EQUAL( delegate::read(a), 1234 );
+  BOOST_CHECK_EQUAL( delegate::read(a), 1234 );
+  BOOST_CHECK( delegate_cache_hit.value() > 0 );
+
+  delegate::call(1, []{ delegate::write(make_global(&some_data), 2345); });
+  // Move past any lease we hold; the next read must see the write.
+  Grappa::mypts() += 2 * FLAGS_lease + 1;
+  BOOST_CHECK_EQUAL( delegate::read(a), 2345 );
+
+  // Our own writes are visible to us immediately.
+  delegate::write(a, 3456);
+  BOOST_CHECK_EQUAL( delegate::read(a), 3456 );
+  BOOST_CHECK_EQUAL( delegate::call(1, []{ return some_data; }), 3456 );
+
+  // More distinct addresses than cache entries forces eviction.
+  const int64_t N = 4 * FLAGS_max_cache_number;
+  auto array = global_alloc<int64_t>(N);
+  forall(array, N, [](int64_t i, int64_t& v) { v = i; });
+  for (int64_t i = 0; i < N; i++) {
+    BOOST_CHECK_EQUAL( delegate::read(array + i), i );
+  }
+  for (int64_t i = 0; i < N; i++) {
+    BOOST_CHECK_EQUAL( delegate::read(array + i), i );
+  }
+  // Evicted payloads were recycled rather than leaked.
+  BOOST_CHECK( GlobalCacheData::payload_arena.live_objects() <= FLAGS_max_cache_number );
+  global_free(array);
+}
+
+void check_batched() {
+  const int64_t N = 40;
+  auto array = global_alloc<int64_t>(N);
+  forall(array, N, [](int64_t i, int64_t& v) { v = 10 * i; });
+
+  // Every element twice, the second copy in reverse order.
+  std::vector<GlobalAddress<int64_t>> targets;
+  for (int64_t i = 0; i < N; i++) targets.push_back(array + i);
+  for (int64_t i = N - 1; i >= 0; i--) targets.push_back(array + i);
+  std::vector<int64_t> results(targets.size());
+
+  Grappa::mypts() += 2 * FLAGS_lease + 1;
+  uint64_t rpcs = delegate_batched_rpcs.value();
+  delegate::read_many(targets.data(), targets.size(), results.data());
+  for (int64_t i = 0; i < N; i++) {
+    BOOST_CHECK_EQUAL( results[i], 10 * i );
+    BOOST_CHECK_EQUAL( results[2 * N - 1 - i], 10 * i );
+  }
+  // Only one owner is remote, and the duplicates are fetched once, at most
+  // half a cache at a time.
+  size_t per_rpc = std::min<size_t>(delegate::batch_size<int64_t>(), FLAGS_max_cache_number / 2);
+  BOOST_CHECK_LE( delegate_batched_rpcs.value() - rpcs, (N + per_rpc - 1) / per_rpc );
+
+  // A second pass is served by the leases just granted.
+  uint64_t hits = delegate_cache_hit.value();
+  delegate::read_many(targets.data(), N, results.data());
+  BOOST_CHECK_GE( delegate_cache_hit.value() - hits, N / 4 );
+
+  std::vector<int64_t> values;
+  for (int64_t i = 0; i < N; i++) values.push_back(-i);
+  delegate::write_many(targets.data(), values.data(), N);
+  for (int64_t i = 0; i < N; i++) {
+    BOOST_CHECK_EQUAL( delegate::read(array + i), -i );
+    BOOST_CHECK_EQUAL( delegate::call(array + i, [](int64_t* p) { return *p; }), -i );
+  }
+  global_free(array);
+
+  // More misses than the cache can hold.
+  const int64_t M = 8 * FLAGS_max_cache_number;
+  auto many = global_alloc<int64_t>(M);
+  forall(many, M, [](int64_t i, int64_t& v) { v = i; });
+  targets.clear();
+  for (int64_t i = 0; i < M; i++) targets.push_back(many + i);
+  results.assign(M, -1);
+  for (auto proto : { GRAPPA_TARDIS, GRAPPA_WI }) {
+    on_all_cores([proto]{ FLAGS_cache_proto = proto; delegate::reset_cache(); });
+    delegate::read_many(targets.data(), M, results.data());
+    for (int64_t i = 0; i < M; i++) BOOST_CHECK_EQUAL( results[i], i );
+  }
+  on_all_cores([]{ FLAGS_cache_proto = GRAPPA_TARDIS; delegate::reset_cache(); });
+  global_free(many);
+}
+
+int64_t renewed_data GRAPPA_BLOCK_ALIGNED = 4567;
+
+// Block on a round trip so the scheduler gets to start the renewal worker
+// (a bare yield loop keeps the ready queue busy).
+template <typename M>
+void wait_for_change(M& metric) {
+  auto v = metric.value();
+  while (metric.value() == v) delegate::call(1, []{});
+}
+
+void check_bg_renewal() {
+  auto a = make_global(&renewed_data, 1);
+  FLAGS_tardis_bg_renewal = true;
+
+  Grappa::mypts() += 2 * FLAGS_lease + 1;
+  BOOST_CHECK_EQUAL( delegate::read(a), 4567 );
+  auto* c = GlobalCacheData::tardis_cache.peek(a.raw_bits());
+  BOOST_REQUIRE( c != nullptr );
+  timestamp_t rts = c->rts;
+
+  // A hit close to the end of the lease queues a renewal.
+  Grappa::mypts() = rts - 1;
+  BOOST_CHECK_EQUAL( delegate::read(a), 4567 );
+  wait_for_change(tardis_bg_renewed);
+  BOOST_CHECK( c->rts > rts );
+
+  // Past the old lease, reads still hit (and queue the next renewal).
+  Grappa::mypts() = rts + 1;
+  uint64_t expired = delegate_cache_expired.value();
+  BOOST_CHECK_EQUAL( delegate::read(a), 4567 );
+  BOOST_CHECK_EQUAL( delegate_cache_expired.value(), expired );
+  wait_for_change(tardis_bg_renewed);
+
+  // Once the owner holds a newer version the renewal fails, and the copy
+  // is refetched when its lease runs out. The copy had not expired, so the
+  // failure does not count as an overwritten expired copy.
+  auto heat = [a]{
+    return delegate::call(1, [a]{
+      return (int)GlobalAddress<int64_t>::find_tardis_owner_info(a).write_heat;
+    });
+  };
+  int old_heat = heat();
+  delegate::call(1, []{ delegate::write(make_global(&renewed_data), 5678); });
+  Grappa::mypts() = c->rts - 1;
+  BOOST_CHECK_EQUAL( delegate::read(a), 4567 );
+  wait_for_change(tardis_bg_renewal_stale);
+  BOOST_CHECK_EQUAL( heat(), old_heat );
+  Grappa::mypts() = c->rts + 1;
+  BOOST_CHECK_EQUAL( delegate::read(a), 5678 );
+
+  FLAGS_tardis_bg_renewal = false;
+}
+
+int64_t modal_data GRAPPA_BLOCK_ALIGNED = 100;
+
+void check_renewal_modes() {
+  auto a = make_global(&modal_data, 1);
+  auto expire = [a] {
+    Grappa::mypts() = GlobalCacheData::tardis_cache.peek(a.raw_bits())->rts + 1;
+  };
+  auto overwrite = [](int64_t v) {
+    delegate::call(1, [v]{ delegate::write(make_global(&modal_data), v); });
+  };
+  uint64_t renewed = tardis_renewal_renewed.value();
+  uint64_t failed = tardis_renewal_failed.value();
+  uint64_t refetched = tardis_renewal_refetched.value();
+
+  // full: every expired copy is refetched.
+  FLAGS_tardis_renewal = "full";
+  BOOST_CHECK_EQUAL( delegate::read(a), 100 );
+  expire();
+  BOOST_CHECK_EQUAL( delegate::read(a), 100 );
+  BOOST_CHECK_EQUAL( tardis_renewal_refetched.value(), ++refetched );
+  BOOST_CHECK_EQUAL( tardis_renewal_renewed.value(), renewed );
+
+  // two_stage: an unchanged copy is renewed, a changed one refetched.
+  FLAGS_tardis_renewal = "two_stage";
+  expire();
+  BOOST_CHECK_EQUAL( delegate::read(a), 100 );
+  BOOST_CHECK_EQUAL( tardis_renewal_renewed.value(), ++renewed );
+  BOOST_CHECK_EQUAL( tardis_renewal_refetched.value(), refetched );
+  overwrite(101);
+  expire();
+  BOOST_CHECK_EQUAL( delegate::read(a), 101 );
+  BOOST_CHECK_EQUAL( tardis_renewal_failed.value(), ++failed );
+  BOOST_CHECK_EQUAL( tardis_renewal_refetched.value(), ++refetched );
+
+  // adaptive: stop trying to renew an object that keeps being overwritten...
+  FLAGS_tardis_renewal = "adaptive";
+  overwrite(102);
+  expire();
+  BOOST_CHECK_EQUAL( delegate::read(a), 102 );
+  BOOST_CHECK_EQUAL( tardis_renewal_failed.value(), ++failed );
+  overwrite(103);
+  expire();
+  BOOST_CHECK_EQUAL( delegate::read(a), 103 );
+  BOOST_CHECK_EQUAL( tardis_renewal_failed.value(), failed );
+  BOOST_CHECK_EQUAL( tardis_renewal_refetched.value(), refetched += 2 );
+
+  // ...and start again once it has cooled down.
+  while (tardis_renewal_renewed.value() == renewed) {
+    expire();
+    BOOST_CHECK_EQUAL( delegate::read(a), 103 );
+    BOOST_CHECK( tardis_renewal_refetched.value() - refetched <= 3 );
+  }
+  BOOST_CHECK_EQUAL( tardis_renewal_failed.value(), failed );
+
+  FLAGS_tardis_renewal = "full";
+}
+
+void check_owner_table() {
+  static char heap[1024] GRAPPA_BLOCK_ALIGNED;
+  impl::OwnerTable<tardis_o_t> table;
+  table.init(heap, sizeof(heap));
+
+  // Objects starting in different blocks get their own slots.
+  auto& a = table.find(1, heap);
+  auto& b = table.find(2, heap + 64);
+  a.rts = 10;
+  b.rts = 20;
+  BOOST_CHECK_EQUAL( &table.find(1, heap), &a );
+  BOOST_CHECK_EQUAL( table.find(2, heap + 64).rts, 20 );
+  BOOST_CHECK_EQUAL( table.find(3, heap + 128).lease, 1 );
+  BOOST_CHECK_EQUAL( table.overflow(), 0 );
+  // Key 0 (the first block of the heap) is a key like any other.
+  BOOST_CHECK_EQUAL( table.find(0, heap + 192).lease, 1 );
+  table.find(0, heap + 192).rts = 50;
+  BOOST_CHECK_EQUAL( table.find(0, heap + 192).rts, 50 );
+  BOOST_CHECK_EQUAL( table.size(), 4 );
+
+  // A second object in a block, or memory outside the heap, still works.
+  auto& c = table.find(4, heap + 8);
+  c.rts = 30;
+  int64_t outside;
+  table.find(5, &outside).rts = 40;
+  BOOST_CHECK_EQUAL( table.find(1, heap).rts, 10 );
+  BOOST_CHECK_EQUAL( table.find(4, heap + 8).rts, 30 );
+  BOOST_CHECK_EQUAL( table.find(5, &outside).rts, 40 );
+  BOOST_CHECK_EQUAL( table.size(), 6 );
+  BOOST_CHECK_EQUAL( table.overflow(), 2 );
+
+  table.clear();
+  BOOST_CHECK_EQUAL( table.size(), 0 );
+  BOOST_CHECK_EQUAL( table.find(1, heap).rts, 0 );
+}
+
+void check_lease_policies() {
+  auto lease_after = [](const char* policy, int reads, int writes) {
+    FLAGS_tardis_lease_policy = policy;
+    BOOST_CHECK_EQUAL( impl::tardis_lease_policy().name, std::string(policy) );
+    tardis_o_t o;
+    for (int w = 0; w < writes; w++) {
+      impl::tardis_lease_policy().revoke(o);
+      for (int r = 0; r < reads; r++) impl::tardis_lease_policy().grant(o);
+    }
+    return (int)o.lease;
+  };
+
+  // linear: one more per read since the last write.
+  BOOST_CHECK_EQUAL( lease_after("linear", 5, 1), 6 );
+  BOOST_CHECK_EQUAL( lease_after("linear", 1000, 1), FLAGS_lease );
+  BOOST_CHECK_EQUAL( lease_after("linear", 5, 20), 6 );
+
+  // exponential: doubled per read, only halved by a write.
+  BOOST_CHECK_EQUAL( lease_after("exponential", 5, 1), 32 );
+  BOOST_CHECK_EQUAL( lease_after("exponential", 1000, 1), FLAGS_lease );
+  BOOST_CHECK_EQUAL( lease_after("exponential", 1, 20), 2 );
+
+  // ratio: the average number of reads per write, so a write-hot object
+  // keeps short leases and a read-mostly one long ones.
+  BOOST_CHECK_EQUAL( lease_after("ratio", 1, 20), 1 );
+  BOOST_CHECK( lease_after("ratio", 10, 20) >= 9 );
+  BOOST_CHECK( lease_after("ratio", 1000, 1) > 30 );
+
+  FLAGS_tardis_lease_policy = "linear";
+}
+
+void check_sharer_set() {
+  impl::SharerSet s;
+  BOOST_CHECK( s.empty() );
+  std::vector<Core> got;
+  auto collect = [&](Core ncores) {
+    got.clear();
+    s.for_each(ncores, [&](Core c) { got.push_back(c); });
+    std::sort(got.begin(), got.end());
+  };
+
+  // Up to MAX_POINTERS sharers are exact, whatever the core count.
+  for (Core c : {300, 7, 300, 9, 1}) s.add(c);
+  BOOST_CHECK( !s.coarse() );
+  collect(400);
+  BOOST_CHECK( got == std::vector<Core>({1, 7, 9, 300}) );
+
+  // One more falls back to the coarse vector: still exact on 64 cores,
+  // a superset beyond.
+  s.add(130);
+  BOOST_CHECK( s.coarse() );
+  collect(64);
+  BOOST_CHECK( got == std::vector<Core>({1, 2, 7, 9, 44}) );
+  collect(400);
+  // Residues 1, 2, 7 and 9 occur 7 times below 400, residue 44 six times.
+  BOOST_CHECK_EQUAL( got.size(), 4 * 7 + 6 );
+  for (Core c : {1, 7, 9, 130, 300}) {
+    BOOST_CHECK( std::find(got.begin(), got.end(), c) != got.end() );
+  }
+
+  s.clear();
+  BOOST_CHECK( s.empty() );
+  collect(400);
+  BOOST_CHECK( got.empty() );
+}
+
+int64_t wi_data GRAPPA_BLOCK_ALIGNED = 10;
+
+void check_wi() {
+  on_all_cores([]{ FLAGS_cache_proto = GRAPPA_WI; });
+  auto a = make_global(&wi_data, 1);
+  auto invalidations = []{ return delegate::call(1, []{ return delegate_inv.value(); }); };
+
+  BOOST_CHECK_EQUAL( delegate::read(a), 10 );
+  BOOST_CHECK_EQUAL( delegate::read(a), 10 );
+
+  // A write at the owner invalidates exactly the one copy there is.
+  uint64_t inv = invalidations();
+  delegate::call_suspendable(1, []{
+    delegate::write(make_global(&wi_data), 11);
+    return true;
+  });
+  BOOST_CHECK_EQUAL( invalidations(), inv + 1 );
+  BOOST_CHECK_EQUAL( delegate::read(a), 11 );
+
+  // A remote writer does not invalidate its own copy.
+  inv = delegate_inv.value();
+  delegate::write(a, 12);
+  BOOST_CHECK_EQUAL( delegate_inv.value(), inv );
+  BOOST_CHECK_EQUAL( delegate::read(a), 12 );
+  BOOST_CHECK_EQUAL( delegate::call(1, []{ return wi_data; }), 12 );
+
+  // Writers that find the object locked are parked at the owner and
+  // served in turn, never retried.
+  auto waits = []{ return delegate::call(1, []{ return delegate_wi_lock_waits.value(); }); };
+  uint64_t parked = waits();
+  forall_here<SyncMode::Blocking,nullptr,1>(0, 8, [a](int64_t i) {
+    if (i == 0) {
+      delegate::call_suspendable(1, []{
+        delegate::write(make_global(&wi_data), 100);
+        return true;
+      });
+    } else {
+      delegate::write(a, 100 + i);
+    }
+    BOOST_CHECK( delegate::read(a) >= 100 );
+  });
+  BOOST_CHECK( waits() > parked );
+  BOOST_CHECK_EQUAL( delegate_wi_lock_retries.value(), 0 );
+  int64_t last = delegate::call(1, []{ return wi_data; });
+  BOOST_CHECK( last >= 100 && last < 108 );
+
+  on_all_cores([]{ FLAGS_cache_proto = GRAPPA_TARDIS; });
+}
+
+// Ranges spanning several blocks, and so both cores, are cached block by
+// block and see writes to any element in them.
+void check_read_range() {
+  const int64_t N = 50;
+  auto array = global_alloc<int64_t>(N);
+  forall(array, N, [](int64_t i, int64_t& v) { v = i; });
+  // Off a block boundary, and ending inside a block.
+  auto start = array + 3;
+  const size_t n = 40;
+  std::vector<int64_t> out(n);
+  auto check = [&](int64_t changed, int64_t value) {
+    delegate::read_range(start, n, out.data());
+    for (size_t i = 0; i < n; i++) {
+      BOOST_CHECK_EQUAL( out[i], 3 + (int64_t)i == changed ? value : 3 + (int64_t)i );
+    }
+  };
+  // Elements owned by core 1, so the writes below are remote to us.
+  int64_t x = 3, y;
+  while ((array + x).core() != 1) x++;
+  y = x + 1;
+
+  for (auto proto : { GRAPPA_TARDIS, GRAPPA_WI }) {
+    on_all_cores([proto]{ FLAGS_cache_proto = proto; });
+    Grappa::mypts() += 2 * FLAGS_lease + 1;
+    check(-1, 0);
+    uint64_t hits = delegate_cache_hit.value();
+    check(-1, 0);
+    BOOST_CHECK( delegate_cache_hit.value() > hits );
+
+    // Written at the owner.
+    delegate::call_suspendable(1, [array, x]{
+      delegate::write(array + x, -x);
+      return true;
+    });
+    Grappa::mypts() += 2 * FLAGS_lease + 1;
+    check(x, -x);
+
+    // Written by us: the stale copy of its block is not used either.
+    delegate::write(array + y, -y);
+    delegate::write(array + x, x);
+    check(y, -y);
+    delegate::write(array + y, y);
+  }
+
+  on_all_cores([]{ FLAGS_cache_proto = GRAPPA_TARDIS; });
+  global_free(array);
+}
+
+struct wide_t { int64_t v[20]; };
+// `w` starts 8 bytes into a block and spans three.
+struct wide_holder { int64_t first; wide_t w; };
+wide_holder wide_data GRAPPA_BLOCK_ALIGNED;
+
+// An object larger than a block is kept coherent in every block it
+// overlaps, so writes to any part of it, whole or not, are never hidden by
+// a cached copy.
+void check_multi_block() {
+  auto w = make_global(&wide_data.w, 1);
+  auto tail = make_global(&wide_data.w.v[15], 1);
+  auto set = [](int64_t x) {
+    wide_t v;
+    for (auto& e : v.v) e = x;
+    return v;
+  };
+  for (auto proto : { GRAPPA_TARDIS, GRAPPA_WI }) {
+    on_all_cores([proto]{ FLAGS_cache_proto = proto; delegate::reset_cache(); });
+    delegate::call(1, [set]{ wide_data.w = set(1); });
+    BOOST_CHECK_EQUAL( GlobalAddress<wide_t>::object_blocks(w), 3 );
+
+    // The owner writes the last block only; our copy of the whole
+    // object must not be older than what we then read of that block.
+    BOOST_CHECK_EQUAL( delegate::read(w).v[15], 1 );
+    delegate::call_suspendable(1, []{
+      delegate::write(make_global(&wide_data.w.v[15]), (int64_t)3);
+      return true;
+    });
+    if (proto == GRAPPA_WI) {
+      BOOST_CHECK_EQUAL( delegate::read(w).v[15], 3 );
+    }
+    BOOST_CHECK_EQUAL( delegate::read(tail), 3 );
+    BOOST_CHECK_EQUAL( delegate::read(w).v[15], 3 );
+
+    // The owner writes the whole object; once we have seen that write
+    // through its first block, the last block, cached on its own, follows.
+    int64_t last[4];
+    delegate::read_range(tail, 4, last);
+    delegate::call_suspendable(1, [set]{
+      delegate::write(make_global(&wide_data.w), set(2));
+      return true;
+    });
+    BOOST_CHECK_EQUAL( delegate::read(make_global(&wide_data.first, 1)), 0 );
+    BOOST_CHECK_EQUAL( delegate::read(w).v[0], 2 );
+    delegate::read_range(tail, 4, last);
+    BOOST_CHECK_EQUAL( last[0], 2 );
+    BOOST_CHECK_EQUAL( last[3], 2 );
+
+    // We write it: our other copies of its blocks are dropped.
+    delegate::write(w, set(4));
+    delegate::read_range(tail, 4, last);
+    BOOST_CHECK_EQUAL( last[3], 4 );
+    BOOST_CHECK_EQUAL( delegate::call(1, []{ return wide_data.w.v[19]; }), 4 );
+  }
+
+  on_all_cores([]{ FLAGS_cache_proto = GRAPPA_TARDIS; delegate::reset_cache(); });
+}
+
+int64_t atomic_data GRAPPA_BLOCK_ALIGNED = 0;
+GlobalCompletionEvent atomic_gce;
+
+// Atomics and delegate::call on a global address change the object like a
+// write does, so no cached copy of it outlives them.
+void check_atomics() {
+  auto a = make_global(&atomic_data, 1);
+  for (auto proto : { GRAPPA_TARDIS, GRAPPA_WI }) {
+    on_all_cores([proto]{ FLAGS_cache_proto = proto; });
+    delegate::call(1, []{ atomic_data = 0; });
+    Grappa::mypts() += 2 * FLAGS_lease + 1;
+
+    // Ours are seen by our next read, though we hold a copy.
+    BOOST_CHECK_EQUAL( delegate::read(a), 0 );
+    BOOST_CHECK_EQUAL( delegate::fetch_and_add(a, 5), 0 );
+    BOOST_CHECK_EQUAL( delegate::read(a), 5 );
+    BOOST_CHECK( delegate::compare_and_swap(a, 5, 7) );
+    BOOST_CHECK( !delegate::compare_and_swap(a, 5, 9) );
+    BOOST_CHECK_EQUAL( delegate::read(a), 7 );
+    delegate::call(a, [](int64_t& x) { x *= 2; });
+    BOOST_CHECK_EQUAL( delegate::read(a), 14 );
+    for (int i = 0; i < 4; i++) delegate::increment<async,&atomic_gce>(a, 1);
+    atomic_gce.wait();
+    BOOST_CHECK_EQUAL( delegate::read(a), 18 );
+
+    // The owner's are seen once our lease, if any, runs out.
+    delegate::call_suspendable(1, [a]{
+      delegate::fetch_and_add(a, 1);
+      return true;
+    });
+    Grappa::mypts() += 2 * FLAGS_lease + 1;
+    BOOST_CHECK_EQUAL( delegate::read(a), 19 );
+    BOOST_CHECK_EQUAL( delegate::call(a, [](int64_t* x) { return *x; }), 19 );
+  }
+  on_all_cores([]{ FLAGS_cache_proto = GRAPPA_TARDIS; });
+}
+
+int64_t wrap_data GRAPPA_BLOCK_ALIGNED = 1;
+
+// Clocks run past 2^32, repeatedly and by large jumps, without copies that
+// have expired ever looking fresh again.
+void check_timestamp_overflow() {
+  auto a = make_global(&wrap_data, 1);
+  const timestamp_t wrap = (timestamp_t)1 << 32;
+  on_all_cores([wrap]{ Grappa::mypts() = wrap - 1; });
+
+  // A lease granted across the 32-bit boundary is still a lease.
+  BOOST_CHECK_EQUAL( delegate::read(a), 1 );
+  auto* c = GlobalCacheData::tardis_cache.peek(a.raw_bits());
+  BOOST_REQUIRE( c != nullptr );
+  BOOST_CHECK( c->rts >= wrap );
+  uint64_t hits = delegate_cache_hit.value();
+  BOOST_CHECK_EQUAL( delegate::read(a), 1 );
+  BOOST_CHECK_EQUAL( delegate_cache_hit.value(), hits + 1 );
+
+  for (int64_t i = 2; i < 66; i++) {
+    delegate::call(1, [i]{ delegate::write(make_global(&wrap_data), i); });
+    Grappa::mypts() += (timestamp_t)1 << 31;
+    BOOST_CHECK_EQUAL( delegate::read(a), i );
+    BOOST_CHECK_EQUAL( delegate::read(a), i );
+    delegate::write(a, -i);
+    BOOST_CHECK_EQUAL( delegate::read(a), -i );
+    BOOST_CHECK_EQUAL( delegate::fetch_and_add(a, 2 * i), -i );
+    BOOST_CHECK_EQUAL( delegate::read(a), i );
+  }
+  BOOST_CHECK( Grappa::mypts() > 32 * wrap );
+}
+
+int64_t epoch_a GRAPPA_BLOCK_ALIGNED = 1;
+int64_t epoch_b GRAPPA_BLOCK_ALIGNED = 1;
+
+// Inside a ReadMostly epoch copies never expire and writes wait for the
+// end of the epoch, which makes all of them visible everywhere.
+void check_epochs() {
+  auto a = make_global(&epoch_a, 1);
+  auto b = make_global(&epoch_b, 0);
+  for (auto proto : { GRAPPA_TARDIS, GRAPPA_WI }) {
+    on_all_cores([proto]{ FLAGS_cache_proto = proto; epoch_a = epoch_b = 1; });
+    Grappa::mypts() += 2 * FLAGS_lease + 1;
+
+    delegate::begin_epoch(EpochMode::ReadMostly);
+    BOOST_CHECK_EQUAL( delegate::read(a), 1 );
+    BOOST_CHECK_EQUAL( delegate::call_suspendable(1, [b]{ return delegate::read(b); }), 1 );
+
+    uint64_t hits = delegate_cache_hit.value();
+    uint64_t expired = delegate_cache_expired.value();
+    Grappa::mypts() += 10 * FLAGS_lease;
+    BOOST_CHECK_EQUAL( delegate::read(a), 1 );
+    BOOST_CHECK_EQUAL( delegate_cache_hit.value(), hits + 1 );
+    BOOST_CHECK_EQUAL( delegate_cache_expired.value(), expired );
+
+    uint64_t buffered = delegate_epoch_writes.value();
+    // Each core writes what the other one has cached.
+    delegate::write(b, 3);
+    delegate::call_suspendable(1, [a]{
+      delegate::write(a, 2);
+      return true;
+    });
+    BOOST_CHECK_EQUAL( delegate_epoch_writes.value(), buffered + 1 );
+    BOOST_CHECK_EQUAL( delegate::read(a), 1 );
+    BOOST_CHECK_EQUAL( delegate::call(1, []{ return epoch_a; }), 1 );
+    BOOST_CHECK_EQUAL( epoch_b, 1 );
+
+    delegate::end_epoch();
+    BOOST_CHECK_EQUAL( delegate::read(a), 2 );
+    BOOST_CHECK_EQUAL( epoch_b, 3 );
+    BOOST_CHECK_EQUAL( delegate::call_suspendable(1, [b]{ return delegate::read(b); }), 3 );
+  }
+  on_all_cores([]{ FLAGS_cache_proto = GRAPPA_TARDIS; });
+}
+
+int64_t buffered_data GRAPPA_BLOCK_ALIGNED = 0;
+
+void check_write_buffer() {
+  auto a = make_global(&buffered_data, 1);
+  auto at_owner = []{ return delegate::call(1, []{ return buffered_data; }); };
+  FLAGS_tardis_write_buffer = 4;
+  // Only the idle check below relies on the wall-clock deadline.
+  int32_t idle_us = FLAGS_tardis_write_buffer_us;
+  FLAGS_tardis_write_buffer_us = 10 * 1000 * 1000;
+
+  // Writes to one address are coalesced and held back; we read our own.
+  uint64_t coalesced = tardis_write_buffer_coalesced.value();
+  for (int64_t i = 1; i <= 3; i++) delegate::write(a, i);
+  BOOST_CHECK_EQUAL( tardis_write_buffer_coalesced.value(), coalesced + 2 );
+  BOOST_CHECK_EQUAL( delegate::read(a), 3 );
+  BOOST_CHECK_EQUAL( at_owner(), 0 );
+
+  // A fence publishes them, and our clock moves past the new version.
+  delegate::flush_writes();
+  BOOST_CHECK_EQUAL( at_owner(), 3 );
+  BOOST_CHECK( Grappa::mypts() >= GlobalCacheData::tardis_cache.peek(a.raw_bits())->wts );
+  BOOST_CHECK_EQUAL( delegate::read(a), 3 );
+
+  // A full buffer is published in one batch per owner.
+  const int64_t N = 4;
+  auto array = global_alloc<int64_t>(N * cores() * block_size / sizeof(int64_t));
+  std::vector<GlobalAddress<int64_t>> remote;
+  for (int64_t i = 0; remote.size() < N; i += block_size / sizeof(int64_t)) {
+    if ((array + i).core() == 1) remote.push_back(array + i);
+  }
+  uint64_t flushes = tardis_write_buffer_flushes.value();
+  uint64_t rpcs = delegate_batched_rpcs.value();
+  for (int64_t i = 0; i < N; i++) delegate::write(remote[i], 100 + i);
+  delegate::flush_writes();
+  BOOST_CHECK_EQUAL( tardis_write_buffer_flushes.value(), flushes + 1 );
+  BOOST_CHECK_EQUAL( delegate_batched_rpcs.value(), rpcs + 1 );
+  for (int64_t i = 0; i < N; i++) {
+    auto r = remote[i];
+    BOOST_CHECK_EQUAL( delegate::call(r.core(), [r]{ return *r.pointer(); }), 100 + i );
+  }
+
+  // Writes of two types are published one type at a time; while they are
+  // in flight, each address still reads its own value.
+  auto d1 = static_cast<GlobalAddress<double>>(remote[1]);
+  auto d3 = static_cast<GlobalAddress<double>>(remote[3]);
+  flushes = tardis_write_buffer_flushes.value();
+  delegate::write(remote[0], 200);
+  delegate::write(d1, 1.5);
+  delegate::write(remote[2], 202);
+  delegate::write(d3, 3.5);
+  while (tardis_write_buffer_flushes.value() == flushes) {
+    delegate::call(1, []{ return true; });
+  }
+  BOOST_CHECK_EQUAL( delegate::read(remote[0]), 200 );
+  BOOST_CHECK_EQUAL( delegate::read(d1), 1.5 );
+  BOOST_CHECK_EQUAL( delegate::read(remote[2]), 202 );
+  BOOST_CHECK_EQUAL( delegate::read(d3), 3.5 );
+  delegate::flush_writes();
+
+  // write_many is not buffered, so it must not be overtaken by an older
+  // buffered write to the same address.
+  delegate::write(remote[0], 300);
+  int64_t v = 301;
+  delegate::write_many(&remote[0], &v, 1);
+  delegate::flush_writes();
+  auto r0 = remote[0];
+  BOOST_CHECK_EQUAL( delegate::call(1, [r0]{ return *r0.pointer(); }), 301 );
+  BOOST_CHECK_EQUAL( delegate::read(remote[0]), 301 );
+
+  // read_range sees a buffered write in the middle of a cached block.
+  const size_t per_block = block_size / sizeof(int64_t);
+  std::vector<int64_t> range(per_block);
+  delegate::read_range(remote[0], per_block, range.data());
+  BOOST_CHECK_EQUAL( range[0], 301 );
+  delegate::write(remote[0] + 3, 303);
+  delegate::read_range(remote[0], per_block, range.data());
+  BOOST_CHECK_EQUAL( range[3], 303 );
+
+  // A core that stops doing Tardis operations still publishes its writes.
+  FLAGS_tardis_write_buffer_us = idle_us;
+  delegate::write(a, 7);
+  double start = Grappa::walltime();
+  while (at_owner() != 7 && Grappa::walltime() - start < 1.0);
+  BOOST_CHECK_EQUAL( at_owner(), 7 );
+
+  // Atomics are fences.
+  delegate::write(a, 10);
+  BOOST_CHECK_EQUAL( delegate::fetch_and_add(a, 1), 10 );
+  BOOST_CHECK_EQUAL( delegate::read(a), 11 );
+
+  FLAGS_tardis_write_buffer = 0;
+  global_free(array);
+}
+
+// Misses to many addresses are all in flight at once, and fill the cache
+// like read() would, under both protocols.
+void check_read_async() {
+  const int64_t N = 32;
+  auto array = global_alloc<int64_t>(N);
+
+  for (int proto : { GRAPPA_TARDIS, GRAPPA_WI }) {
+    on_all_cores([proto]{ FLAGS_cache_proto = proto; delegate::reset_cache(); });
+    forall(array, N, [](int64_t i, int64_t& v) { v = 7 * i; });
+    std::vector<delegate::ReadPromise<int64_t>> rs;
+    for (int64_t i = 0; i < N; i++) rs.push_back(delegate::read_async(array + i));
+    for (int64_t i = 0; i < N; i++) BOOST_CHECK_EQUAL( rs[i].get(), 7 * i );
+
+    // Now cached: served before read_async returns.
+    uint64_t hits = delegate_cache_hit.value();
+    for (int64_t i = 0; i < N; i++) {
+      auto r = delegate::read_async(array + i);
+      BOOST_CHECK( r.ready() );
+      BOOST_CHECK_EQUAL( r.get(), 7 * i );
+    }
+    BOOST_CHECK( delegate_cache_hit.value() > hits );
+
+    // A handle dropped unread waits for its reply.
+    for (int64_t i = 0; i < N; i++) delegate::write(array + i, 3 * i);
+    if (proto == GRAPPA_TARDIS) Grappa::mypts() += 2 * FLAGS_lease + 1;
+    on_all_cores([]{ delegate::reset_cache(); });
+    delegate::read_async(array + 1);
+    BOOST_CHECK_EQUAL( delegate::read(array + 1), 3 );
+
+    // More reads in flight than the cache holds: past half of it they are
+    // served synchronously.
+    const int64_t M = 8 * FLAGS_max_cache_number;
+    auto many = global_alloc<int64_t>(M);
+    forall(many, M, [](int64_t i, int64_t& v) { v = i; });
+    auto pinned = [proto]{
+      return proto == GRAPPA_TARDIS ? GlobalCacheData::tardis_cache.pinned() :
+                                      GlobalCacheData::wi_cache.pinned();
+    };
+    size_t max_pinned = 0;
+    rs.clear();
+    for (int64_t i = 0; i < M; i++) {
+      rs.push_back(delegate::read_async(many + i));
+      max_pinned = std::max(max_pinned, pinned());
+    }
+    BOOST_CHECK_LE( max_pinned, FLAGS_max_cache_number / 2 );
+    for (int64_t i = 0; i < M; i++) BOOST_CHECK_EQUAL( rs[i].get(), i );
+    BOOST_CHECK_EQUAL( pinned(), 0 );
+    global_free(many);
+  }
+  on_all_cores([]{ FLAGS_cache_proto = GRAPPA_TARDIS; delegate::reset_cache(); });
+  global_free(array);
+}
+
+int64_t locale_data GRAPPA_BLOCK_ALIGNED = 77;
+
+// Copies fetched by one core of a locale serve the others. Both cores of
+// this test share a locale, but core 1 owns the data, so core 0 plays both
+// parts by dropping its private copy.
+void check_locale_cache() {
+  using Grappa::impl::LocaleCache;
+  std::vector<LocaleCache::slot_t> slots(4);
+  LocaleCache a, b;
+  a.attach(slots.data(), slots.size());
+  b.attach(slots.data(), slots.size());
+  int64_t v = 42, out = 0;
+  uint64_t wts, rts;
+  BOOST_CHECK( a.publish(8, &v, sizeof(v), 5, 10) );
+  BOOST_CHECK( b.read(8, sizeof(v), 10, &out, &wts, &rts) );
+  BOOST_CHECK_EQUAL( out, 42 );
+  BOOST_CHECK_EQUAL( wts, 5 );
+  BOOST_CHECK_EQUAL( rts, 10 );
+  // Past its lease, or read as another type, the copy is not used.
+  BOOST_CHECK( !b.read(8, sizeof(v), 11, &out, &wts, &rts) );
+  BOOST_CHECK( !b.read(8, sizeof(int32_t), 10, &out, &wts, &rts) );
+  // An older version never replaces a newer one.
+  int64_t old = 1;
+  BOOST_CHECK( !a.publish(8, &old, sizeof(old), 4, 20) );
+  BOOST_CHECK( b.read(8, sizeof(v), 10, &out, &wts, &rts) );
+  BOOST_CHECK_EQUAL( out, 42 );
+  a.clear();
+  BOOST_CHECK( !b.read(8, sizeof(v), 10, &out, &wts, &rts) );
+  BOOST_CHECK_EQUAL( b.size(), 0 );
+
+  on_all_cores([]{ FLAGS_tardis_locale_cache = 64; delegate::reset_cache(); });
+  auto x = make_global(&locale_data, 1);
+  BOOST_CHECK_EQUAL( delegate::read(x), 77 );
+
+  GlobalAddress<int64_t>::free_cache();
+  GlobalCacheData::tardis_cache.clear();
+  GlobalCacheData::payload_arena.clear();
+  uint64_t hits = tardis_locale_cache_hit.value();
+  uint64_t ops = delegate_ops.value();
+  BOOST_CHECK_EQUAL( delegate::read(x), 77 );
+  BOOST_CHECK_EQUAL( tardis_locale_cache_hit.value(), hits + 1 );
+  BOOST_CHECK_EQUAL( delegate_ops.value(), ops );
+
+  // Once our clock is past the lease, the owner is asked again.
+  delegate::call(1, []{ locale_data = 78; });
+  Grappa::mypts() += 2 * FLAGS_lease + 1;
+  BOOST_CHECK_EQUAL( delegate::read(x), 78 );
+  BOOST_CHECK_EQUAL( GlobalCacheData::locale_cache.size(), 1 );
+
+  // The shared table is reported once per locale.
+  uint64_t entries = tardis_locale_cache_entries.value() +
+    delegate::call(1, []{ return tardis_locale_cache_entries.value(); });
+  BOOST_CHECK_EQUAL( entries, GlobalCacheData::locale_cache.size() );
+
+  on_all_cores([]{ FLAGS_tardis_locale_cache = 0; delegate::reset_cache(); });
+}
+
+int64_t hot_data GRAPPA_BLOCK_ALIGNED = 1;
+
+// An object read often enough is promoted by its owner: readers get long
+// leases and are sent each new version instead of coming back for it.
+void check_hot_keys() {
+  on_all_cores([]{
+    FLAGS_tardis_hot_sample = 1;
+    FLAGS_tardis_hot_threshold = 3;
+    FLAGS_tardis_hot_window = 4;
+    delegate::reset_cache();
+  });
+  auto x = make_global(&hot_data, 1);
+  auto promotions = []{ return delegate::call(1, []{ return tardis_hot_promotions.value(); }); };
+  uint64_t promoted = promotions();
+  for (int i = 0; i < 3; i++) {
+    Grappa::mypts() += 2 * FLAGS_lease + 1;
+    BOOST_CHECK_EQUAL( delegate::read(x), 1 );
+  }
+  BOOST_CHECK_EQUAL( promotions(), promoted + 1 );
+  BOOST_CHECK( GlobalCacheData::tardis_cache.peek(x.raw_bits())->rts >=
+      Grappa::mypts() + FLAGS_tardis_hot_lease - 1 );
+
+  // A write at the owner reaches our cached copy without a read.
+  uint64_t applied = tardis_hot_push_applied.value();
+  delegate::call(1, []{ delegate::write(make_global(&hot_data), 5); });
+  while (tardis_hot_push_applied.value() == applied) Grappa::yield();
+  uint64_t ops = delegate_ops.value();
+  BOOST_CHECK_EQUAL( delegate::read(x), 5 );
+  BOOST_CHECK_EQUAL( delegate_ops.value(), ops );
+
+  // The next read closes the window, in which it was read too few times
+  // since its promotion, so it is demoted.
+  uint64_t demoted = delegate::call(1, []{ return tardis_hot_demotions.value(); });
+  Grappa::mypts() += 2 * FLAGS_tardis_hot_lease + 1;
+  BOOST_CHECK_EQUAL( delegate::read(x), 5 );
+  BOOST_CHECK_EQUAL( delegate::call(1, []{ return tardis_hot_demotions.value(); }), demoted + 1 );
+
+  on_all_cores([]{
+    FLAGS_tardis_hot_sample = 0;
+    FLAGS_tardis_hot_threshold = 16;
+    FLAGS_tardis_hot_window = 4096;
+    delegate::reset_cache();
+  });
+}
+
+struct hot_pair { int64_t a, b; };
+hot_pair hot_pair_data GRAPPA_BLOCK_ALIGNED = { 1, 2 };
+
+// Objects sharing a block share its owner metadata, so promoting one
+// promotes the block: its siblings are tracked and pushed under the same
+// entry, and the block is demoted as a whole.
+void check_hot_block() {
+  on_all_cores([]{
+    FLAGS_tardis_hot_sample = 1;
+    FLAGS_tardis_hot_threshold = 3;
+    FLAGS_tardis_hot_window = 8;
+    delegate::reset_cache();
+  });
+  auto a = make_global(&hot_pair_data.a, 1);
+  auto b = make_global(&hot_pair_data.b, 1);
+  auto hot_blocks = []{ return delegate::call(1, []{ return GlobalCacheData::tardis_hot_keys.size(); }); };
+  for (int i = 0; i < 3; i++) {
+    Grappa::mypts() += 2 * FLAGS_lease + 1;
+    BOOST_CHECK_EQUAL( delegate::read(a), 1 );
+  }
+  BOOST_CHECK_EQUAL( hot_blocks(), 1 );
+  BOOST_CHECK_EQUAL( delegate::read(b), 2 );
+  BOOST_CHECK_EQUAL( hot_blocks(), 1 );
+
+  // A write to the sibling is pushed to readers of the block.
+  uint64_t applied = tardis_hot_push_applied.value();
+  delegate::call(1, []{ delegate::write(make_global(&hot_pair_data.b), 6); });
+  while (tardis_hot_push_applied.value() == applied) Grappa::yield();
+  uint64_t ops = delegate_ops.value();
+  BOOST_CHECK_EQUAL( delegate::read(b), 6 );
+  BOOST_CHECK_EQUAL( delegate_ops.value(), ops );
+
+  // Raise the bar so the block is demoted when the window closes.
+  uint64_t demoted = delegate::call(1, []{
+    FLAGS_tardis_hot_threshold = 100;
+    return tardis_hot_demotions.value();
+  });
+  for (int i = 0; i < 2 * FLAGS_tardis_hot_window; i++) {
+    if (delegate::call(1, []{ return tardis_hot_demotions.value(); }) != demoted) break;
+    Grappa::mypts() += 2 * FLAGS_tardis_hot_lease + 1;
+    BOOST_CHECK_EQUAL( delegate::read(b), 6 );
+  }
+  BOOST_CHECK_EQUAL( delegate::call(1, []{ return tardis_hot_demotions.value(); }), demoted + 1 );
+  BOOST_CHECK_EQUAL( hot_blocks(), 0 );
+
+  on_all_cores([]{
+    FLAGS_tardis_hot_sample = 0;
+    FLAGS_tardis_hot_threshold = 16;
+    FLAGS_tardis_hot_window = 4096;
+    delegate::reset_cache();
+  });
+}
+
+// With -tardis_owner_batch, refetches that reach the owner together are
+// served by one drain and answered in one reply.
+void check_owner_batch() {
+  const int64_t N = 16;
+  auto array = global_alloc<int64_t>(N * cores() * block_size / sizeof(int64_t));
+  std::vector<GlobalAddress<int64_t>> remote;
+  for (int64_t i = 0; (int64_t)remote.size() < N; i += block_size / sizeof(int64_t)) {
+    if ((array + i).core() == 1) remote.push_back(array + i);
+  }
+  for (int64_t i = 0; i < N; i++) delegate::write(remote[i], 10 + i);
+  on_all_cores([]{ FLAGS_tardis_owner_batch = true; delegate::reset_cache(); });
+
+  auto at_owner = []{
+    return delegate::call(1, []{
+      return std::make_pair(tardis_owner_batches.value(), tardis_owner_batched_reads.value());
+    });
+  };
+  auto before = at_owner();
+  // An idle owner serves each request as it comes; keep it busy so that
+  // they queue up.
+  send_heap_message(1, []{ usleep(20000); });
+  std::vector<delegate::ReadPromise<int64_t>> rs;
+  for (int64_t i = 0; i < N; i++) rs.push_back(delegate::read_async(remote[i]));
+  for (int64_t i = 0; i < N; i++) BOOST_CHECK_EQUAL( rs[i].get(), 10 + i );
+  auto after = at_owner();
+  BOOST_CHECK_EQUAL( after.second, before.second + N );
+  BOOST_CHECK( after.first - before.first < (uint64_t)N );
+
+  // Blocking reads take the same path, and the copies are cached as usual.
+  Grappa::mypts() += 2 * FLAGS_lease + 1;
+  auto r = remote[0];
+  delegate::call(1, [r]{ *r.pointer() = 99; });
+  BOOST_CHECK_EQUAL( delegate::read(r), 99 );
+  uint64_t hits = delegate_cache_hit.value();
+  BOOST_CHECK_EQUAL( delegate::read(r), 99 );
+  BOOST_CHECK_EQUAL( delegate_cache_hit.value(), hits + 1 );
+
+  on_all_cores([]{ FLAGS_tardis_owner_batch = false; delegate::reset_cache(); });
+  global_free(array);
+}
+
+// -delegate_trace logs reads and writes, in order, for CoherenceSim.exe.
+void check_delegate_trace() {
+  auto x = make_global(&locale_data, 1);
+  int pid = getpid();
+  std::string prefix = "/tmp/TardisCache_tests.trace." + std::to_string(pid);
+  on_all_cores([pid]{
+    FLAGS_delegate_trace = "/tmp/TardisCache_tests.trace." + std::to_string(pid);
+    impl::start_delegate_trace();
+  });
+  delegate::read(x);
+  delegate::write(x, (int64_t)5);
+  delegate::read(make_global(&locale_data));
+  on_all_cores([]{
+    FLAGS_delegate_trace = "";
+    impl::finish_delegate_trace();
+  });
+
+  impl::trace_header h;
+  std::vector<impl::trace_record> records;
+  std::string path = prefix + ".0";
+  BOOST_CHECK( impl::read_trace(path.c_str(), &h, &records) );
+  unlink(path.c_str());
+  BOOST_CHECK_EQUAL( h.core, 0 );
+  BOOST_CHECK_EQUAL( h.cores, cores() );
+  BOOST_REQUIRE_EQUAL( records.size(), 3 );
+  BOOST_CHECK( records[0].op == impl::TraceOp::Read );
+  BOOST_CHECK( records[1].op == impl::TraceOp::Write );
+  BOOST_CHECK_EQUAL( records[0].address, x.raw_bits() );
+  BOOST_CHECK_EQUAL( records[0].owner, 1 );
+  BOOST_CHECK_EQUAL( records[0].size, sizeof(int64_t) );
+  BOOST_CHECK_EQUAL( records[2].owner, 0 );
+  BOOST_CHECK( records[0].time <= records[1].time && records[1].time <= records[2].time );
+
+  // A core that issued nothing still leaves a file for the replayer.
+  path = prefix + ".1";
+  records.clear();
+  BOOST_CHECK( impl::read_trace(path.c_str(), &h, &records) );
+  unlink(path.c_str());
+  BOOST_CHECK_EQUAL( h.core, 1 );
+  BOOST_CHECK_EQUAL( h.cores, cores() );
+  BOOST_CHECK_EQUAL( records.size(), 0 );
+}
+
+BOOST_AUTO_TEST_CASE( test1 ) {
+  FLAGS_cache_proto = GRAPPA_TARDIS;
+  FLAGS_max_cache_number = 16;
+  Grappa::init( GRAPPA_TEST_ARGS );
+  Grappa::run([]{
+    check_table();
+    check_arena();
+    check_tardis();
+    check_batched();
+    check_bg_renewal();
+    check_renewal_modes();
+    check_owner_table();
+    check_lease_policies();
+    check_sharer_set();
+    check_wi();
+    check_read_range();
+    check_multi_block();
+    check_atomics();
+    check_timestamp_overflow();
+    check_epochs();
+    check_write_buffer();
+    check_read_async();
+    check_locale_cache();
+    check_hot_keys();
+    check_hot_block();
+    check_owner_batch();
+    check_delegate_trace();
+  });
+  Grappa::finalize();
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -97,6 +97,9 @@ namespace Grappa {
 
   /// Specify whether an operation goes through the cache.
   enum class CacheMode { WriteBack /*default*/, WriteThrough };
+
+  /// Coherence guarantees of cached delegates within an epoch (see delegate::begin_epoch).
+  enum class EpochMode { Normal /*default*/, ReadMostly };
     
   
 /// "Universal" wallclock time (works at least for Mac, and most Linux)